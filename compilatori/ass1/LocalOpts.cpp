@@ -1,196 +1,1021 @@
 #include "llvm/Transforms/Utils/LocalOpts.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/InstrTypes.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/ScopedHashTable.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/OptimizationRemarkEmitter.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/TypeFinder.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/KnownBits.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include <optional>
 // L'include seguente va in LocalOpts.h
 // #include <llvm/IR/Constants.h>
 
 using namespace llvm;
 
+#define DEBUG_TYPE "localopts"
+
+STATISTIC(NumAlgebraicIdentity, "Number of algebraic identities applied");
+STATISTIC(NumMulStrengthReduction, "Number of multiplications strength reduced");
+STATISTIC(NumDivStrengthReduction, "Number of divisions and remainders strength reduced");
+STATISTIC(NumMultiInstruction, "Number of multi-instruction optimizations applied");
+STATISTIC(NumConstantChainFolding, "Number of constant chains folded");
+STATISTIC(NumFPAlgebraicIdentity, "Number of floating point algebraic identities applied");
+STATISTIC(NumFPStrengthReduction, "Number of floating point operations strength reduced");
+STATISTIC(NumCommonSubexpression, "Number of common subexpressions eliminated");
+STATISTIC(NumDeadInstructions, "Number of dead instructions erased");
+
+// Modello di costo usato per decidere se scomporre una moltiplicazione
+static cl::opt<TargetTransformInfo::TargetCostKind> MulCostKind(
+    "localopts-mul-cost-kind", cl::init(TargetTransformInfo::TCK_Latency),
+    cl::desc("Cost kind used to compare a multiplication with its shift/add chain"),
+    cl::values(clEnumValN(TargetTransformInfo::TCK_Latency, "latency", "Critical path latency"),
+               clEnumValN(TargetTransformInfo::TCK_RecipThroughput, "throughput", "Reciprocal throughput"),
+               clEnumValN(TargetTransformInfo::TCK_CodeSize, "code-size", "Code size")));
+
+// La catena viene usata se costa meno di questa percentuale della moltiplicazione
+static cl::opt<unsigned> MulCostThreshold(
+    "localopts-mul-cost-threshold", cl::init(100),
+    cl::desc("Maximum cost of a shift/add chain, in percent of the multiplication it replaces"));
+
+// Thread usati per la fase di analisi (0 = tutti quelli disponibili)
+static cl::opt<unsigned> LocalOptsThreads(
+    "localopts-threads", cl::init(0),
+    cl::desc("Number of threads used to build the rewrite plans (0 = hardware concurrency)"));
+
+// Funzioni analizzate da ogni task del thread pool
+static cl::opt<unsigned> PlanBatchSize(
+    "localopts-batch-size", cl::init(64), cl::Hidden,
+    cl::desc("Number of functions planned by each task of the thread pool"));
+
+// Costo della moltiplicazione quando il target non fornisce una tabella
+static cl::opt<unsigned> DefaultMulCost(
+    "localopts-default-mul-cost", cl::init(3),
+    cl::desc("Multiplication cost relative to a shift when the target has no cost table"));
+
+
+/**
+ * Registra una riscrittura: aggiorna la statistica del tipo di riscrittura
+ * ed emette un optimization remark con l'istruzione originale e il rimpiazzo.
+ * Il remark va emesso prima che l'istruzione originale venga rimossa
+*/
+void reportRewrite(OptimizationRemarkEmitter &ORE, Statistic &Counter, StringRef RemarkName,
+                   Instruction &Inst, Value *Replacement) {
+    ++Counter;
+    ORE.emit([&]() {
+        return OptimizationRemark(DEBUG_TYPE, RemarkName, &Inst)
+               << "replaced " << ore::NV("Original", &Inst)
+               << " with " << ore::NV("Replacement", Replacement);
+    });
+}
+
+/**
+ * Elementi di un vettore costante di interi. Fallisce se un elemento
+ * non e' una ConstantInt (es. undef)
+*/
+bool getConstantIntElements(const Value *V, SmallVectorImpl<APInt> &Elements) {
+    if (auto *CDV = dyn_cast<ConstantDataVector>(V)) {
+        if (!CDV->getElementType()->isIntegerTy())
+            return false;
+        for (unsigned i = 0, e = CDV->getNumElements(); i != e; ++i)
+            Elements.push_back(CDV->getElementAsAPInt(i));
+        return true;
+    }
+    if (auto *CV = dyn_cast<ConstantVector>(V)) {
+        for (const Use &Op : CV->operands()) {
+            auto *Elt = dyn_cast<ConstantInt>(Op);
+            if (!Elt)
+                return false;
+            Elements.push_back(Elt->getValue());
+        }
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Costante intera, scalare o splat vettoriale.
+ * A differenza di m_APInt legge soltanto i dati delle costanti esistenti:
+ * getSplatValue e getAggregateElement possono creare le costanti degli
+ * elementi nel LLVMContext, quindi non si possono usare nella fase di analisi
+*/
+std::optional<APInt> getConstantInt(const Value *V) {
+    if (auto *CI = dyn_cast<ConstantInt>(V))
+        return CI->getValue();
+    if (!V->getType()->isIntOrIntVectorTy())
+        return std::nullopt;
+    if (isa<ConstantAggregateZero>(V))
+        return APInt::getZero(V->getType()->getScalarSizeInBits());
+
+    SmallVector<APInt, 8> Elements;
+    if (!getConstantIntElements(V, Elements) || !is_splat(Elements))
+        return std::nullopt;
+    return Elements[0];
+}
+
+/**
+ * Costante floating point, scalare o splat vettoriale, letta come getConstantInt
+*/
+std::optional<APFloat> getConstantFP(const Value *V) {
+    if (auto *CF = dyn_cast<ConstantFP>(V))
+        return CF->getValueAPF();
+    if (!V->getType()->isFPOrFPVectorTy())
+        return std::nullopt;
+    if (isa<ConstantAggregateZero>(V))
+        return APFloat::getZero(V->getType()->getScalarType()->getFltSemantics());
+
+    std::optional<APFloat> Splat;
+    auto IsSplatElement = [&Splat](const APFloat &Elt) {
+        if (!Splat)
+            Splat = Elt;
+        return Splat->bitwiseIsEqual(Elt);
+    };
+    if (auto *CDV = dyn_cast<ConstantDataVector>(V)) {
+        for (unsigned i = 0, e = CDV->getNumElements(); i != e; ++i)
+            if (!IsSplatElement(CDV->getElementAsAPFloat(i)))
+                return std::nullopt;
+    } else if (auto *CV = dyn_cast<ConstantVector>(V)) {
+        for (const Use &Op : CV->operands()) {
+            auto *Elt = dyn_cast<ConstantFP>(Op);
+            if (!Elt || !IsSplatElement(Elt->getValueAPF()))
+                return std::nullopt;
+        }
+    }
+    return Splat;
+}
+
+/**
+ * Forma affine di un valore rispetto ad una base comune:
+ * Value = Base * Scale + Offset, ottenuta risalendo una catena
+ * di add/sub/mul/shl con un operando costante
+*/
+struct AffineChain {
+    Value *Base = nullptr;
+    APInt Scale;
+    APInt Offset;
+    // Istruzioni della catena, a partire da quella riscritta
+    SmallVector<Instruction *, 4> Links;
+    // La catena contiene solo add/sub con la costante come secondo operando
+    bool OnlyAddSub = true;
+    // Tutte le istruzioni hanno nsw e la somma degli offset non va in overflow
+    bool NoSignedWrap = true;
+    // Tutte le istruzioni sono add con nuw
+    bool NoUnsignedWrap = true;
+    // Scala -2^k: il risultato e' Offset - (Base << k)
+    bool IsNegatedShift = false;
+};
+
+/**
+ * Sequenza scelta per una divisione o un resto per una costante,
+ * con il magic number gia' calcolato
+*/
+struct DivisionPlan {
+    enum StrategyTy {
+        NegateOrZero,  // x / -1 = -x, x % -1 = 0
+        SmallDividend, // dividendo sempre minore del divisore: quoziente 0, resto x
+        Mask,          // x % 2^k senza segno = x & (2^k - 1)
+        ExactShift,    // dividendo multiplo di 2^k: ashr senza bias
+        Quotient       // shift o magic number, il resto e' x - (x / d) * d
+    } Strategy = Quotient;
+    // Divisore, gia' in valore assoluto se la divisione e' diventata senza segno
+    APInt D;
+    bool IsSigned = false;
+    bool IsRem = false;
+    bool NegateQuotient = false;
+    // Magic number, calcolato solo se la sequenza lo usa
+    APInt Magic;
+    unsigned Shift = 0;
+    bool IsAdd = false;
+};
+
+/**
+ * Riscrittura di una istruzione decisa dalla fase di analisi.
+ * Contiene solo dati (indici degli operandi, costanti come APInt/APFloat):
+ * le nuove istruzioni e le costanti nel LLVMContext vengono create
+ * dalla fase di applicazione
+*/
+struct Rewrite {
+    enum KindTy {
+        AlgebraicIdentity,   // l'istruzione vale l'operando Operand
+        AlgebraicZero,       // l'istruzione vale 0
+        MultiInstruction,    // vale l'operando SourceOperand del suo operando Operand
+        ConstantChain,       // Chain.Base * Chain.Scale + Chain.Offset
+        MulShiftVector,      // operando Operand << ShiftAmounts, elemento per elemento
+        MulShiftAddChain,    // catena di shift e add/sub dei Terms sull'operando Operand
+        NonUniformDivision,  // lshr / and con gli ShiftAmounts del divisore
+        Division,            // sequenza descritta da Div
+        FPAlgebraicIdentity, // l'istruzione vale l'operando Operand
+        FPReciprocal,        // primo operando * Reciprocal
+        FPDouble             // operando Operand + se stesso
+    } Kind = AlgebraicIdentity;
+    unsigned Operand = 0;
+    unsigned SourceOperand = 0;
+    SmallVector<unsigned, 4> ShiftAmounts;
+    SmallVector<std::pair<unsigned, bool>, 8> Terms;
+    bool NeedsNegation = false;
+    AffineChain Chain;
+    DivisionPlan Div;
+    std::optional<APFloat> Reciprocal;
+};
+
 /**
- * Funzione che esegue la algebraic identity per i casi:
+ * Costo relativo di moltiplicazione, shift e add/sub per un tipo.
+ * I costi vengono dal TargetTransformInfo; se il target non distingue
+ * la moltiplicazione da una shift (es. modulo senza triple) si usa
+ * la tabella di default
+*/
+struct MulCostModel {
+    InstructionCost Mul;
+    InstructionCost Shift;
+    InstructionCost AddSub;
+};
+
+/**
+ * Dati comuni alle decisioni su una funzione. La cache dei modelli
+ * di costo evita di interrogare il TargetTransformInfo per ogni moltiplicazione.
+ * Durante la fase di analisi (IsScan) il contesto e' usato da un solo thread
+ * e non deve toccare il LLVMContext: IsDeferred segnala che una decisione
+ * ne avrebbe bisogno e va rimandata alla fase di applicazione
+*/
+struct PlanContext {
+    PlanContext(const TargetTransformInfo &TTI, const DataLayout &DL) : TTI(TTI), DL(DL) {}
+
+    const TargetTransformInfo &TTI;
+    const DataLayout &DL;
+    DenseMap<Type *, MulCostModel> MulCosts;
+    bool IsScan = false;
+    bool IsDeferred = false;
+};
+
+/**
+ * Modello di costo della moltiplicazione per il tipo Ty. Le query sui costi
+ * possono creare tipi nel LLVMContext, quindi durante la fase di analisi
+ * il modello deve essere gia' in cache (vedi computeMulCostModels)
+*/
+MulCostModel getMulCostModel(Type *Ty, PlanContext &Ctx) {
+    auto It = Ctx.MulCosts.find(Ty);
+    if (It != Ctx.MulCosts.end())
+        return It->second;
+    assert(!Ctx.IsScan && "Multiplication cost queried during the parallel scan");
+
+    MulCostModel Model;
+    Model.Mul = Ctx.TTI.getArithmeticInstrCost(Instruction::Mul, Ty, MulCostKind);
+    Model.Shift = Ctx.TTI.getArithmeticInstrCost(Instruction::Shl, Ty, MulCostKind);
+    Model.AddSub = Ctx.TTI.getArithmeticInstrCost(Instruction::Add, Ty, MulCostKind);
+
+    if (!Model.Mul.isValid() || !Model.Shift.isValid() || !Model.AddSub.isValid() || Model.Mul <= Model.Shift) {
+        Model.Mul = DefaultMulCost.getValue();
+        Model.Shift = 1;
+        Model.AddSub = 1;
+    }
+    Ctx.MulCosts[Ty] = Model;
+    return Model;
+}
+
+/**
+ * Riempie la cache dei modelli di costo con i tipi di tutte le moltiplicazioni
+ * della funzione. Viene chiamata prima del thread pool, cosi' la fase di analisi
+ * non interroga mai il TargetTransformInfo
+*/
+void computeMulCostModels(Function &F, PlanContext &Ctx) {
+    for (Instruction &Inst : instructions(F))
+        if (Inst.getOpcode() == Instruction::Mul)
+            getMulCostModel(Inst.getType(), Ctx);
+}
+
+/**
+ * Known bits del valore X nel punto CxtI. Sugli interi scalari computeKnownBits
+ * legge soltanto l'IR; sui vettori legge gli elementi delle costanti con
+ * getAggregateElement, che puo' crearle nel LLVMContext: durante la fase
+ * di analisi la decisione viene rimandata alla fase di applicazione
+*/
+std::optional<KnownBits> getKnownBits(const Value *X, const Instruction &CxtI, PlanContext &Ctx) {
+    if (Ctx.IsScan && X->getType()->isVectorTy()) {
+        Ctx.IsDeferred = true;
+        return std::nullopt;
+    }
+    return computeKnownBits(X, Ctx.DL, 0, nullptr, &CxtI);
+}
+
+/**
+ * Funzione che cerca la algebraic identity per i casi:
  * a + 0 = 0 + a = a
  * a - 0 = a
  * a * 1 = 1 * a = a
- * a / 1 = a
+ * a / 1 = a (con e senza segno)
+ * a % 1 = 0 (con e senza segno)
+ * anche per i vettori con costanti splat
 */
-bool performAlgebraicIdentity(Instruction &Inst, Instruction::BinaryOps OptType) {
+bool planAlgebraicIdentity(Instruction &Inst, Instruction::BinaryOps OptType, Rewrite &R) {
 	// Controlla entrambi gli operandi per la possibilità di algebraic identity
-    for (unsigned i = 0; i < 2; ++i) {		
-		// Effettua la conversione dinamica degli operandi
-		if (auto *C = dyn_cast<ConstantInt>(Inst.getOperand(i))){
-			// Controllo il tipo di operazione
-			switch (OptType) {
-				case Instruction::Add: {
-					// Se uno degli operandi è zero, sostituisco l'istruzione con l'altro operando
-					if (C->isZero()) {
-						Inst.replaceAllUsesWith(Inst.getOperand(1-i));
-						llvm::outs() << "Algebraic identity applied:" << Inst << "  =>" << *Inst.getOperand(1-i) << "\n";
-						return true;
-					} 
-					break;
-				}
-				case Instruction::Sub: {
-					// Se il secondo operando è zero, sostituisco l'istruzione con il primo operando
-					if (i == 1 && C->isZero()) {
-						Inst.replaceAllUsesWith(Inst.getOperand(1-i));
-						llvm::outs() << "Algebraic identity applied:" << Inst << "  =>" << *Inst.getOperand(1-i) << "\n";
-						return true;
-					} 
-					break;
-				}
-				case Instruction::Mul: {
-					// Se uno degli operandi è uno, sostituisco l'istruzione con l'altro operando
-					if (C->isOne()) {
-						Inst.replaceAllUsesWith(Inst.getOperand(1-i));
-						llvm::outs() << "Algebraic identity applied:" << Inst << "  =>" << *Inst.getOperand(1-i) << "\n";
-						return true;
-					} 
-					break;
-				}
-				case Instruction::SDiv: {
-					// Se il secondo operando è uno, sostituisco l'istruzione con l'altro operando
-					if (i == 1 && C->isOne()) {
-						Inst.replaceAllUsesWith(Inst.getOperand(1-i));
-						llvm::outs() << "Algebraic identity applied:" << Inst << "  =>" << *Inst.getOperand(1-i) << "\n";
-						return true;
-					}
-					break;
-				}
+    for (unsigned i = 0; i < 2; ++i) {
+		// Cerca una costante intera, scalare o splat vettoriale
+		std::optional<APInt> C = getConstantInt(Inst.getOperand(i));
+		if (!C)
+			continue;
 
-				default:
-					break;
+		bool IsIdentity = false;
+		// Controllo il tipo di operazione
+		switch (OptType) {
+			case Instruction::Add: {
+				// Se uno degli operandi è zero, l'istruzione vale l'altro operando
+				IsIdentity = C->isZero();
+				break;
+			}
+			case Instruction::Sub: {
+				// Se il secondo operando è zero, l'istruzione vale il primo operando
+				IsIdentity = i == 1 && C->isZero();
+				break;
+			}
+			case Instruction::Mul: {
+				// Se uno degli operandi è uno, l'istruzione vale l'altro operando
+				IsIdentity = C->isOne();
+				break;
+			}
+			case Instruction::SDiv:
+			case Instruction::UDiv: {
+				// Se il secondo operando è uno, l'istruzione vale il primo operando
+				IsIdentity = i == 1 && C->isOne();
+				break;
 			}
+			case Instruction::SRem:
+			case Instruction::URem: {
+				// Se il secondo operando è uno, il resto è sempre zero
+				if (i == 1 && C->isOne()) {
+					R.Kind = Rewrite::AlgebraicZero;
+					return true;
+				}
+				break;
+			}
+
+			default:
+				break;
+		}
+
+		if (IsIdentity) {
+			R.Kind = Rewrite::AlgebraicIdentity;
+			R.Operand = 1 - i;
+			return true;
 		}
 	}
     return false; // Nessuna identità algebrica trovata
 }
 
 /**
- * Funzione che esegue la strength reduction per le moltiplicazioni
- * Se la costante che moltiplica e' una potenza di due, eseguo una shift
- * Se la costante e' a distanza +/- 1 di una potenza di due, calcolo il 
- * logaritmo, eseguo la shift e poi sommo o sottrago la costante
+ * Scompone la costante in forma canonical signed digit (NAF):
+ * C = somma di +/- 2^k con il minimo numero di termini non nulli.
+ * Ogni termine e' la coppia (k, segno); l'aritmetica e' modulo 2^n,
+ * quindi funziona anche per le costanti negative e i termini con k >= n
+ * vengono scartati
+*/
+void computeCanonicalSignedDigits(const APInt &C, SmallVectorImpl<std::pair<unsigned, bool>> &Terms) {
+    APInt V = C;
+    for (unsigned Pos = 0; Pos < C.getBitWidth() && !V.isZero(); ++Pos) {
+        if (V[0]) {
+            // V mod 4 == 1 -> cifra +1, V mod 4 == 3 -> cifra -1
+            bool IsNegative = V[1];
+            Terms.push_back({Pos, IsNegative});
+            if (IsNegative)
+                ++V;
+            else
+                --V;
+        }
+        V.lshrInPlace(1);
+    }
+}
+
+/**
+ * Se V e' un vettore costante (non splat) con tutti gli elementi potenza di due,
+ * calcola i logaritmi da usare come amount della shift
 */
-bool performMultiplicationStrengthReduction(Instruction &Inst) {
+bool getLog2ShiftAmounts(const Value *V, SmallVectorImpl<unsigned> &ShiftAmounts) {
+    SmallVector<APInt, 8> Elements;
+    if (!getConstantIntElements(V, Elements) || is_splat(Elements))
+        return false;
+
+    for (const APInt &Elt : Elements) {
+        if (!Elt.isPowerOf2())
+            return false;
+        ShiftAmounts.push_back(Elt.logBase2());
+    }
+    return true;
+}
+
+/**
+ * Vettore costante con gli amount calcolati da getLog2ShiftAmounts
+*/
+Constant *createShiftAmounts(Type *Ty, ArrayRef<unsigned> ShiftAmounts) {
+    SmallVector<Constant *, 8> Elements;
+    for (unsigned Amount : ShiftAmounts)
+        Elements.push_back(ConstantInt::get(Ty->getScalarType(), Amount));
+    return ConstantVector::get(Elements);
+}
+
+/**
+ * Funzione che decide la strength reduction per le moltiplicazioni
+ * per una costante qualsiasi: la costante viene scomposta in forma
+ * canonical signed digit e la moltiplicazione diventa una catena di
+ * shift e add/sub, es. x * 10 = (x << 3) + (x << 1), x * 15 = (x << 4) - x.
+ * La catena viene scelta solo se secondo il modello di costo
+ * costa meno della moltiplicazione.
+ * Sui vettori la costante deve essere uno splat, oppure un vettore
+ * di potenze di due (una shift con un amount per elemento)
+*/
+bool planMultiplicationStrengthReduction(Instruction &Inst, PlanContext &Ctx, Rewrite &R) {
     // Controlla entrambi gli operandi per la possibilità di strength reduction
     for (unsigned i = 0; i < 2; ++i) {
-        if (auto *C = dyn_cast<ConstantInt>(Inst.getOperand(i))) {
-            if (C->getValue().isPowerOf2()) {
-                // Se il valore è una costante potenza di due, esegui uno shift a sinistra
-                Value *X = Inst.getOperand(1 - i);
-                BinaryOperator *ShiftOp = BinaryOperator::Create(Instruction::Shl, X, ConstantInt::get(C->getType(), C->getValue().exactLogBase2()));
-                ShiftOp->insertAfter(&Inst);
-                Inst.replaceAllUsesWith(ShiftOp);
-                llvm::outs() << "Strength reduction applied:" << Inst << "  =>" << *ShiftOp << "\n";
-                return true;
-            } else {
-                // Se il valore non è una costante potenza di due, esegui la strength reduction con shift e sottrazione o addizione
-				Value *X = Inst.getOperand(1 - i);
-				APInt Value = C->getValue();
-
-				// Controlla se il valore è +/-1 rispetto a una potenza di due
-				if ((Value - 1).isPowerOf2() || (Value + 1).isPowerOf2()) {
-					// Calcola la potenza di due più vicina
-					APInt NearestPower = (Value - 1).isPowerOf2() ? Value - 1 : Value + 1;
-					unsigned NearestShift = NearestPower.logBase2(); // Calcola lo shift amount per la potenza di due più vicina
-
-					// Esegui lo shift a sinistra della potenza di due più vicina
-					BinaryOperator *ShiftOp = BinaryOperator::Create(Instruction::Shl, X, ConstantInt::get(X->getType(), NearestShift));
-					ShiftOp->insertAfter(&Inst);
-
-					// Esegui un'operazione di sottrazione o addizione se necessario 				
-					if (NearestPower == (Value + 1)) {
-						// Se l'aggiustamento è negativo, esegui un'operazione di sottrazione
-						BinaryOperator *SubOp = BinaryOperator::Create(Instruction::Sub, ShiftOp, X);
-						SubOp->insertAfter(ShiftOp);
-						Inst.replaceAllUsesWith(SubOp);
-						llvm::outs() << "Strength reduction applied:" << Inst << "  =>" << *ShiftOp << "  and" << *SubOp << "\n";
-					} else {
-						// Altrimenti, esegui un'operazione di addizione
-						BinaryOperator *AddOp = BinaryOperator::Create(Instruction::Add, ShiftOp, X);
-						AddOp->insertAfter(ShiftOp);
-						Inst.replaceAllUsesWith(AddOp);
-						llvm::outs() << "Strength reduction applied:" << Inst << "  =>" << *ShiftOp << "  and" << *AddOp << "\n";
-					}
-
-					return true;
-				}
-            }
+        // Vettore non uniforme di potenze di due: una shift per elemento
+        SmallVector<unsigned, 4> ShiftAmounts;
+        if (getLog2ShiftAmounts(Inst.getOperand(i), ShiftAmounts)) {
+            R.Kind = Rewrite::MulShiftVector;
+            R.Operand = 1 - i;
+            R.ShiftAmounts = std::move(ShiftAmounts);
+            return true;
         }
+
+        std::optional<APInt> C = getConstantInt(Inst.getOperand(i));
+        if (!C || C->isZero())
+            continue;
+
+        SmallVector<std::pair<unsigned, bool>, 8> Terms;
+        computeCanonicalSignedDigits(*C, Terms);
+
+        // Si parte dal termine positivo piu' alto, se c'e', per non dover negare
+        std::reverse(Terms.begin(), Terms.end());
+        auto FirstPositive = llvm::find_if(Terms, [](const std::pair<unsigned, bool> &T) { return !T.second; });
+        bool NeedsNegation = FirstPositive == Terms.end();
+        if (!NeedsNegation)
+            std::rotate(Terms.begin(), FirstPositive, FirstPositive + 1);
+
+        // Costo della catena: le shift sono indipendenti, le add/sub in sequenza
+        MulCostModel Model = getMulCostModel(Inst.getType(), Ctx);
+        unsigned NumShifts = llvm::count_if(Terms, [](const std::pair<unsigned, bool> &T) { return T.first > 0; });
+        unsigned NumAddSub = Terms.size() - 1 + (NeedsNegation ? 1 : 0);
+        InstructionCost ChainCost;
+        if (MulCostKind == TargetTransformInfo::TCK_Latency)
+            ChainCost = (NumShifts > 0 ? Model.Shift : InstructionCost(0)) + Model.AddSub * NumAddSub;
+        else
+            ChainCost = Model.Shift * NumShifts + Model.AddSub * NumAddSub;
+
+        if (ChainCost * 100 >= Model.Mul * MulCostThreshold.getValue())
+            continue;
+
+        R.Kind = Rewrite::MulShiftAddChain;
+        R.Operand = 1 - i;
+        R.Terms = std::move(Terms);
+        R.NeedsNegation = NeedsNegation;
+        return true;
     }
-	
+
     return false;
 }
 
 /**
- * Funzione che esegue la strength reduction per le divisioni
- * Se la costante che divide e' una potenza di due eseguo una shift
+ * Genera la catena di shift e add/sub scelta da planMultiplicationStrengthReduction
 */
-bool performDivisionStrengthReduction(Instruction &Inst) {
-    // Se il secondo operando è una costante potenza di due
-    if (auto *C = dyn_cast<ConstantInt>(Inst.getOperand(1))) {
-        if (C->getValue().isPowerOf2()) {
-            // Eseguiamo uno shift a destra per la potenza di due
-            Value *X = Inst.getOperand(0);
-            BinaryOperator *ShiftOp = BinaryOperator::Create(Instruction::AShr, X, ConstantInt::get(C->getType(), C->getValue().logBase2()));
-            ShiftOp->insertAfter(&Inst);
-            Inst.replaceAllUsesWith(ShiftOp);
-            llvm::outs() << "Strength reduction applied:" << Inst << "  =>" << *ShiftOp << "\n";
-            return true;
+Value *createShiftAddChain(IRBuilder<> &Builder, Value *X, ArrayRef<std::pair<unsigned, bool>> Terms, bool NeedsNegation) {
+    auto CreateTerm = [&](unsigned Shift) -> Value * {
+        return Shift ? Builder.CreateShl(X, Shift) : X;
+    };
+
+    Value *Result = CreateTerm(Terms[0].first);
+    if (NeedsNegation)
+        Result = Builder.CreateNeg(Result);
+    for (const auto &Term : drop_begin(Terms)) {
+        Value *Shifted = CreateTerm(Term.first);
+        Result = Term.second ? Builder.CreateSub(Result, Shifted) : Builder.CreateAdd(Result, Shifted);
+    }
+    return Result;
+}
+
+/**
+ * Calcola il magic number per la divisione con segno per la costante D
+ * (Hacker's Delight, cap. 10): x / D = mulhs(x, Magic) >> Shift
+ * piu' le correzioni di segno
+*/
+void computeSignedMagic(const APInt &D, APInt &Magic, unsigned &Shift) {
+    unsigned BitWidth = D.getBitWidth();
+    APInt SignedMin = APInt::getSignedMinValue(BitWidth);
+    APInt AbsD = D.abs();
+    APInt T = SignedMin + D.lshr(BitWidth - 1);
+    APInt ANC = T - 1 - T.urem(AbsD);
+    unsigned P = BitWidth - 1;
+    APInt Q1 = SignedMin.udiv(ANC);
+    APInt R1 = SignedMin - Q1 * ANC;
+    APInt Q2 = SignedMin.udiv(AbsD);
+    APInt R2 = SignedMin - Q2 * AbsD;
+    APInt Delta;
+
+    do {
+        P = P + 1;
+        Q1 <<= 1;
+        R1 <<= 1;
+        if (R1.uge(ANC)) {
+            ++Q1;
+            R1 -= ANC;
+        }
+        Q2 <<= 1;
+        R2 <<= 1;
+        if (R2.uge(AbsD)) {
+            ++Q2;
+            R2 -= AbsD;
+        }
+        Delta = AbsD - R2;
+    } while (Q1.ult(Delta) || (Q1 == Delta && R1.isZero()));
+
+    Magic = Q2 + 1;
+    if (D.isNegative())
+        Magic.negate();
+    Shift = P - BitWidth;
+}
+
+/**
+ * Calcola il magic number per la divisione senza segno per la costante D
+ * (Hacker's Delight, cap. 10): x / D = mulhu(x, Magic) >> Shift.
+ * Se IsAdd e' vero il magic number non sta in BitWidth bit e serve
+ * la sequenza con l'addizione
+*/
+void computeUnsignedMagic(const APInt &D, APInt &Magic, unsigned &Shift, bool &IsAdd) {
+    unsigned BitWidth = D.getBitWidth();
+    APInt AllOnes = APInt::getAllOnes(BitWidth);
+    APInt SignedMin = APInt::getSignedMinValue(BitWidth);
+    APInt SignedMax = APInt::getSignedMaxValue(BitWidth);
+    APInt NC = AllOnes - (AllOnes - D).urem(D);
+    unsigned P = BitWidth - 1;
+    APInt Q1 = SignedMin.udiv(NC);
+    APInt R1 = SignedMin - Q1 * NC;
+    APInt Q2 = SignedMax.udiv(D);
+    APInt R2 = SignedMax - Q2 * D;
+    APInt Delta;
+    IsAdd = false;
+
+    do {
+        P = P + 1;
+        if (R1.uge(NC - R1)) {
+            Q1 = Q1 + Q1 + 1;
+            R1 = R1 + R1 - NC;
+        } else {
+            Q1 = Q1 + Q1;
+            R1 = R1 + R1;
         }
+        if ((R2 + 1).uge(D - R2)) {
+            if (Q2.uge(SignedMax))
+                IsAdd = true;
+            Q2 = Q2 + Q2 + 1;
+            R2 = R2 + R2 + 1 - D;
+        } else {
+            if (Q2.uge(SignedMin))
+                IsAdd = true;
+            Q2 = Q2 + Q2;
+            R2 = R2 + R2 + 1;
+        }
+        Delta = D - 1 - R2;
+    } while (P < BitWidth * 2 && (Q1.ult(Delta) || (Q1 == Delta && R1.isZero())));
+
+    Magic = Q2 + 1;
+    Shift = P - BitWidth;
+}
+
+/**
+ * Genera la parte alta del prodotto X * Magic, estendendo gli operandi
+ * al doppio dei bit
+*/
+Value *createMulHigh(IRBuilder<> &Builder, Value *X, const APInt &Magic, bool IsSigned) {
+    unsigned BitWidth = Magic.getBitWidth();
+    Type *WideTy = X->getType()->getWithNewBitWidth(BitWidth * 2);
+    Value *WideX = IsSigned ? Builder.CreateSExt(X, WideTy) : Builder.CreateZExt(X, WideTy);
+    APInt WideMagic = IsSigned ? Magic.sext(BitWidth * 2) : Magic.zext(BitWidth * 2);
+    Value *Product = Builder.CreateMul(WideX, ConstantInt::get(WideTy, WideMagic));
+    return Builder.CreateTrunc(Builder.CreateLShr(Product, BitWidth), X->getType());
+}
+
+/**
+ * Genera la sequenza che calcola X / D con segno, arrotondando verso zero.
+ * Le potenze di due (anche negative) usano la shift con il bias sui negativi,
+ * le altre costanti il magic number con le correzioni di segno
+*/
+Value *createSignedDivision(IRBuilder<> &Builder, Value *X, const DivisionPlan &Div) {
+    const APInt &D = Div.D;
+    unsigned BitWidth = D.getBitWidth();
+
+    // x / INT_MIN vale 1 solo se x == INT_MIN, altrimenti 0
+    if (D.isMinSignedValue())
+        return Builder.CreateZExt(Builder.CreateICmpEQ(X, ConstantInt::get(X->getType(), D)), X->getType());
+
+    APInt AbsD = D.abs();
+    if (AbsD.isPowerOf2()) {
+        // (x + ((x >> (k - 1)) >>> (n - k))) >> k: il bias vale 2^k - 1 solo se x < 0
+        unsigned K = AbsD.logBase2();
+        Value *Sign = Builder.CreateAShr(X, K - 1);
+        Value *Bias = Builder.CreateLShr(Sign, BitWidth - K);
+        Value *Quotient = Builder.CreateAShr(Builder.CreateAdd(X, Bias), K);
+        return D.isNegative() ? Builder.CreateNeg(Quotient) : Quotient;
     }
 
-    return false;
+    const APInt &Magic = Div.Magic;
+    Value *Quotient = createMulHigh(Builder, X, Magic, true);
+    // Il magic number ha segno opposto al divisore: correzione con x
+    if (D.isStrictlyPositive() && Magic.isNegative())
+        Quotient = Builder.CreateAdd(Quotient, X);
+    else if (D.isNegative() && Magic.isStrictlyPositive())
+        Quotient = Builder.CreateSub(Quotient, X);
+    if (Div.Shift > 0)
+        Quotient = Builder.CreateAShr(Quotient, Div.Shift);
+    // Aggiungo 1 se il quoziente e' negativo, per arrotondare verso zero
+    Value *SignBit = Builder.CreateLShr(Quotient, BitWidth - 1);
+    return Builder.CreateAdd(Quotient, SignBit);
+}
+
+/**
+ * Genera la sequenza che calcola X / D senza segno
+*/
+Value *createUnsignedDivision(IRBuilder<> &Builder, Value *X, const DivisionPlan &Div) {
+    const APInt &D = Div.D;
+    // Un divisore con il bit alto a uno da' quoziente 0 oppure 1
+    if (D.isNegative())
+        return Builder.CreateZExt(Builder.CreateICmpUGE(X, ConstantInt::get(X->getType(), D)), X->getType());
+
+    if (D.isPowerOf2())
+        return Builder.CreateLShr(X, D.logBase2());
+
+    Value *Quotient = createMulHigh(Builder, X, Div.Magic, false);
+    if (!Div.IsAdd)
+        return Div.Shift > 0 ? Builder.CreateLShr(Quotient, Div.Shift) : Quotient;
+
+    // Il magic number ha un bit in piu': ((x - q) >> 1 + q) >> (s - 1)
+    Value *Diff = Builder.CreateLShr(Builder.CreateSub(X, Quotient), 1);
+    return Builder.CreateLShr(Builder.CreateAdd(Diff, Quotient), Div.Shift - 1);
 }
 
 /**
- * Funzione che esegue l'ottimizzazione multi-istruzione
+ * Strength reduction per divisioni e resti per un vettore costante non uniforme:
+ * e' possibile solo se ogni elemento e' una potenza di due e la divisione
+ * e' senza segno (o con segno ma con dividendo non negativo):
+ * x / c = x >> log2(c), x % c = x & (c - 1) elemento per elemento
+*/
+bool planNonUniformDivisionStrengthReduction(Instruction &Inst, PlanContext &Ctx, Rewrite &R) {
+    SmallVector<unsigned, 4> ShiftAmounts;
+    if (!getLog2ShiftAmounts(Inst.getOperand(1), ShiftAmounts))
+        return false;
+
+    unsigned Opcode = Inst.getOpcode();
+    if (Opcode == Instruction::SDiv || Opcode == Instruction::SRem) {
+        std::optional<KnownBits> Known = getKnownBits(Inst.getOperand(0), Inst, Ctx);
+        if (!Known || !Known->isNonNegative())
+            return false;
+    }
+
+    R.Kind = Rewrite::NonUniformDivision;
+    R.ShiftAmounts = std::move(ShiftAmounts);
+    return true;
+}
+
+/**
+ * Funzione che decide la strength reduction per divisioni e resti
+ * per una costante qualsiasi (sdiv, udiv, srem, urem).
+ * La divisione diventa una shift o una moltiplicazione per il magic number,
+ * il resto viene calcolato come x - (x / c) * c, o con una and per le potenze di due.
+ * I known bits del dividendo permettono di scegliere la sequenza piu' economica:
+ * - dividendo non negativo: la divisione con segno diventa senza segno (lshr / and)
+ * - dividendo multiplo di 2^k (o divisione exact): ashr senza bias
+ * - dividendo sempre minore del divisore: quoziente 0, resto x
+ * Sui vettori il divisore deve essere uno splat; i vettori non uniformi
+ * sono gestiti da planNonUniformDivisionStrengthReduction
+*/
+bool planDivisionStrengthReduction(Instruction &Inst, PlanContext &Ctx, Rewrite &R) {
+    std::optional<APInt> C = getConstantInt(Inst.getOperand(1));
+    if (!C)
+        return planNonUniformDivisionStrengthReduction(Inst, Ctx, R);
+    // Le divisioni per 1 sono gia' gestite dalla algebraic identity, quelle per 0 non si toccano
+    if (C->isZero() || C->isOne())
+        return false;
+
+    unsigned Opcode = Inst.getOpcode();
+    DivisionPlan Div;
+    Div.IsSigned = Opcode == Instruction::SDiv || Opcode == Instruction::SRem;
+    Div.IsRem = Opcode == Instruction::SRem || Opcode == Instruction::URem;
+    Div.D = *C;
+    std::optional<KnownBits> MaybeKnown = getKnownBits(Inst.getOperand(0), Inst, Ctx);
+    if (!MaybeKnown)
+        return false;
+    const KnownBits &Known = *MaybeKnown;
+    APInt &D = Div.D;
+
+    if (Div.IsSigned && D.isAllOnes()) {
+        Div.Strategy = DivisionPlan::NegateOrZero;
+    } else {
+        // Con il dividendo non negativo x / d = -(x / |d|) e x % d = x % |d| senza segno
+        if (Div.IsSigned && !D.isMinSignedValue() && Known.isNonNegative()) {
+            Div.IsSigned = false;
+            Div.NegateQuotient = D.isNegative();
+            D = D.abs();
+        }
+
+        if (!Div.IsSigned && Known.getMaxValue().ult(D)) {
+            Div.Strategy = DivisionPlan::SmallDividend;
+        } else if (!Div.IsSigned && Div.IsRem && D.isPowerOf2()) {
+            Div.Strategy = DivisionPlan::Mask;
+        } else if (Div.IsSigned && D.abs().isPowerOf2() && ((isa<PossiblyExactOperator>(Inst) && Inst.isExact()) || Known.countMinTrailingZeros() >= D.abs().logBase2())) {
+            Div.Strategy = DivisionPlan::ExactShift;
+        } else {
+            Div.Strategy = DivisionPlan::Quotient;
+            // Le potenze di due e i divisori con il bit alto a uno non usano il magic number
+            if (Div.IsSigned && !D.isMinSignedValue() && !D.abs().isPowerOf2())
+                computeSignedMagic(D, Div.Magic, Div.Shift);
+            else if (!Div.IsSigned && !D.isNegative() && !D.isPowerOf2())
+                computeUnsignedMagic(D, Div.Magic, Div.Shift, Div.IsAdd);
+        }
+    }
+
+    R.Kind = Rewrite::Division;
+    R.Div = std::move(Div);
+    return true;
+}
+
+/**
+ * Genera la sequenza scelta da planDivisionStrengthReduction per X / D o X % D
+*/
+Value *createDivision(IRBuilder<> &Builder, Value *X, const DivisionPlan &Div) {
+    Type *Ty = X->getType();
+    const APInt &D = Div.D;
+
+    switch (Div.Strategy) {
+        case DivisionPlan::NegateOrZero:
+            return Div.IsRem ? Constant::getNullValue(Ty) : Builder.CreateNeg(X);
+        case DivisionPlan::SmallDividend:
+            // Il dividendo e' sempre minore del divisore
+            return Div.IsRem ? X : Constant::getNullValue(Ty);
+        case DivisionPlan::Mask:
+            return Builder.CreateAnd(X, ConstantInt::get(Ty, D - 1));
+        case DivisionPlan::ExactShift: {
+            // Il dividendo e' multiplo del divisore: la shift aritmetica e' gia' esatta
+            Value *Quotient = Builder.CreateAShr(X, D.abs().logBase2());
+            Quotient = D.isNegative() ? Builder.CreateNeg(Quotient) : Quotient;
+            return Div.IsRem ? Constant::getNullValue(Ty) : Quotient;
+        }
+        case DivisionPlan::Quotient:
+            break;
+    }
+
+    Value *Quotient = Div.IsSigned ? createSignedDivision(Builder, X, Div) : createUnsignedDivision(Builder, X, Div);
+    if (Div.IsRem)
+        return Builder.CreateSub(X, Builder.CreateMul(Quotient, ConstantInt::get(Ty, D)));
+    return Div.NegateQuotient ? Builder.CreateNeg(Quotient) : Quotient;
+}
+
+/**
+ * Restituisce V se e' un operatore binario con l'opcode cercato
+*/
+BinaryOperator *getBinaryOperator(Value *V, unsigned Opcode) {
+    auto *BinOp = dyn_cast<BinaryOperator>(V);
+    return BinOp && BinOp->getOpcode() == Opcode ? BinOp : nullptr;
+}
+
+/**
+ * Funzione che cerca l'ottimizzazione multi-istruzione
  * Solo nei casi simili ai seguenti
  * a = b + 1, c = a - 1 => c = b
  * a = b - 1, c = 1 + a => c = b
+ * La decisione riguarda l'istruzione ridondante (c), che vale
+ * un operando della sua sorgente (a)
 */
-bool performMultiInstructionOptimization(Instruction &Inst, Instruction::BinaryOps OptType) {
-    // Ottimizziamo sequenze di istruzioni multiple
-    for (auto *User : Inst.users()) {
-        if (auto *BinOp = dyn_cast<BinaryOperator>(User)) {
-            // La mia istruzione e' una Add
-            if (OptType == Instruction::Add) {
-                // Cerchiamo una Sub
-                if (BinOp->getOpcode() == Instruction::Sub) {
-                    // Se il primo operando della sottrazione coincide con l'addizione
-                    if (BinOp->getOperand(0) == &Inst) {
-                        // Se il secondo operando è uguale a uno dei due operandi dell'addizione
-                        if (BinOp->getOperand(1) == Inst.getOperand(0) || BinOp->getOperand(1) == Inst.getOperand(1)) {
-                            // Sostituisci con l'altro operando dell'addizione
-                            BinOp->replaceAllUsesWith(Inst.getOperand(0));
-                            llvm::outs() << "Multi Instruction Optimization:" << Inst << "  and" << *BinOp <<"\n";
-                            return true;
-                        }
-                    }
+bool planMultiInstructionOptimization(Instruction &Inst, Instruction::BinaryOps OptType, Rewrite &R) {
+    // La mia istruzione e' una Sub
+    if (OptType == Instruction::Sub) {
+        // Cerchiamo una Add come primo operando della sottrazione
+        if (BinaryOperator *Source = getBinaryOperator(Inst.getOperand(0), Instruction::Add)) {
+            // Se il secondo operando è uguale a uno dei due operandi dell'addizione
+            for (unsigned k = 0; k < 2; ++k) {
+                if (Inst.getOperand(1) == Source->getOperand(k)) {
+                    // L'istruzione vale l'altro operando dell'addizione
+                    R.Kind = Rewrite::MultiInstruction;
+                    R.Operand = 0;
+                    R.SourceOperand = 1 - k;
+                    return true;
                 }
             }
-            // La mia istruzione e' una Sub
-            else if (OptType == Instruction::Sub) {
-                // Cerchiamo una Add
-                if (BinOp->getOpcode() == Instruction::Add) {
-                    // Se il primo operando della addizione coincide con la sottrazione
-                    if (BinOp->getOperand(0) == &Inst) {
-                        // Se il secondo operando della sottrazione coincide con l'altro della addizione
-                        if (BinOp->getOperand(1) == Inst.getOperand(1)) {
-                            // Sostituisci con il primo operando della sottrazione
-                            BinOp->replaceAllUsesWith(Inst.getOperand(0));
-                            llvm::outs() << "Multi Instruction Optimization:" << Inst << "  and" << *BinOp <<"\n";
-                            return true;
-                        }
-                    }
-                    // Se il secondo operando della addizione coincide con la sottrazione e il primo operando della addizione coincide con il secondo operando della sottrazione
-                    else if (BinOp->getOperand(0) == Inst.getOperand(1)) {
-                        // Sostituisci con il primo operando della sottrazione
-                        BinOp->replaceAllUsesWith(Inst.getOperand(0));
-                        llvm::outs() << "Multi Instruction Optimization:" << Inst << "  and" << *BinOp <<"\n";
-                        return true;
-                    }
-                }
+        }
+    }
+    // La mia istruzione e' una Add
+    else if (OptType == Instruction::Add) {
+        // Cerchiamo una Sub tra gli operandi della addizione
+        for (unsigned i = 0; i < 2; ++i) {
+            BinaryOperator *Source = getBinaryOperator(Inst.getOperand(i), Instruction::Sub);
+            // Se l'altro operando della addizione coincide con il secondo operando della sottrazione
+            if (Source && Inst.getOperand(1 - i) == Source->getOperand(1)) {
+                // L'istruzione vale il primo operando della sottrazione
+                R.Kind = Rewrite::MultiInstruction;
+                R.Operand = i;
+                R.SourceOperand = 0;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+AffineChain computeAffineChain(Instruction &Inst) {
+    unsigned BitWidth = Inst.getType()->getScalarSizeInBits();
+    AffineChain Chain;
+    Chain.Base = &Inst;
+    Chain.Scale = APInt(BitWidth, 1);
+    Chain.Offset = APInt(BitWidth, 0);
+
+    // Value = Scale * Cur + Offset: ad ogni passo Cur viene sostituito dal suo operando.
+    // Un anello con altri usi resta vivo dopo la riscrittura e non fa risparmiare
+    // nulla: la catena si ferma li' e l'anello diventa la base
+    while (auto *Cur = dyn_cast<BinaryOperator>(Chain.Base)) {
+        if (Cur != &Inst && !Cur->hasOneUse())
+            break;
+        std::optional<APInt> LHS = getConstantInt(Cur->getOperand(0));
+        std::optional<APInt> RHS = getConstantInt(Cur->getOperand(1));
+        unsigned Opcode = Cur->getOpcode();
+        Value *X;
+        bool Overflow = false;
+        if (Opcode == Instruction::Add && (LHS || RHS)) {
+            X = Cur->getOperand(RHS ? 0 : 1);
+            Chain.Offset = Chain.Offset.sadd_ov(Chain.Scale * (RHS ? *RHS : *LHS), Overflow);
+        } else if (Opcode == Instruction::Sub && RHS) {
+            X = Cur->getOperand(0);
+            Chain.Offset = Chain.Offset.ssub_ov(Chain.Scale * *RHS, Overflow);
+            Chain.NoUnsignedWrap = false;
+        } else if (Opcode == Instruction::Sub && LHS) {
+            X = Cur->getOperand(1);
+            Chain.Offset += Chain.Scale * *LHS;
+            Chain.Scale.negate();
+            Chain.OnlyAddSub = false;
+        } else if (Opcode == Instruction::Mul && (LHS || RHS)) {
+            X = Cur->getOperand(RHS ? 0 : 1);
+            Chain.Scale *= RHS ? *RHS : *LHS;
+            Chain.OnlyAddSub = false;
+        } else if (Opcode == Instruction::Shl && RHS && RHS->ult(BitWidth)) {
+            X = Cur->getOperand(0);
+            Chain.Scale <<= *RHS;
+            Chain.OnlyAddSub = false;
+        } else {
+            break;
+        }
+
+        Chain.NoSignedWrap &= Cur->hasNoSignedWrap() && !Overflow;
+        Chain.NoUnsignedWrap &= Cur->hasNoUnsignedWrap();
+        Chain.Base = X;
+        Chain.Links.push_back(Cur);
+    }
+
+    return Chain;
+}
+
+/**
+ * Funzione che decide la riassociazione delle catene di costanti:
+ * una catena di add/sub/mul/shl con un operando costante sopra una base
+ * comune viene ridotta a Base * Scale + Offset, es.
+ * a = b + 3, c = a - 5 => c = b - 2
+ * a = b * 3, c = a << 2 => c = b * 12
+ * La catena viene riscritta solo se servono meno istruzioni.
+ * nsw/nuw vengono mantenuti solo per le catene di sole add/sub
+ * in cui ogni istruzione li aveva e gli offset non vanno in overflow
+*/
+bool planConstantChainFolding(Instruction &Inst, Rewrite &R) {
+    AffineChain Chain = computeAffineChain(Inst);
+    APInt NegScale = -Chain.Scale;
+    // Con la scala -2^k il risultato e' Offset - (Base << k), la sub assorbe l'offset
+    Chain.IsNegatedShift = !Chain.Scale.isPowerOf2() && NegScale.isPowerOf2();
+
+    unsigned NewLength;
+    if (Chain.Scale.isZero())
+        NewLength = 0;
+    else if (Chain.IsNegatedShift)
+        NewLength = (NegScale.isOne() ? 0 : 1) + 1;
+    else
+        NewLength = (Chain.Scale.isOne() ? 0 : 1) + (Chain.Offset.isZero() ? 0 : 1);
+    if (Chain.Links.size() < 2 || NewLength >= Chain.Links.size())
+        return false;
+
+    R.Kind = Rewrite::ConstantChain;
+    R.Chain = std::move(Chain);
+    return true;
+}
+
+/**
+ * Genera Base * Scale + Offset per la catena scelta da planConstantChainFolding
+*/
+Value *createAffineChain(IRBuilder<> &Builder, Type *Ty, const AffineChain &Chain) {
+    if (Chain.Scale.isZero())
+        return ConstantInt::get(Ty, Chain.Offset);
+
+    if (Chain.IsNegatedShift) {
+        APInt NegScale = -Chain.Scale;
+        Value *Shifted = NegScale.isOne() ? Chain.Base : Builder.CreateShl(Chain.Base, NegScale.logBase2());
+        return Builder.CreateSub(ConstantInt::get(Ty, Chain.Offset), Shifted);
+    }
+
+    Value *Result;
+    if (Chain.Scale.isOne())
+        Result = Chain.Base;
+    else if (Chain.Scale.isPowerOf2())
+        Result = Builder.CreateShl(Chain.Base, Chain.Scale.logBase2());
+    else
+        Result = Builder.CreateMul(Chain.Base, ConstantInt::get(Ty, Chain.Scale));
+
+    if (!Chain.Offset.isZero()) {
+        bool KeepFlags = Chain.OnlyAddSub;
+        Result = Builder.CreateAdd(Result, ConstantInt::get(Ty, Chain.Offset), "",
+                                   KeepFlags && Chain.NoUnsignedWrap, KeepFlags && Chain.NoSignedWrap);
+    }
+    return Result;
+}
+
+/**
+ * Funzione che cerca la algebraic identity per le operazioni floating point,
+ * rispettando i fast-math flag dell'istruzione:
+ * a + (-0.0) = a
+ * a + 0.0 = a       (solo con nsz: -0.0 + 0.0 = 0.0)
+ * a - 0.0 = a
+ * a - (-0.0) = a    (solo con nsz)
+ * a * 1.0 = a
+ * a / 1.0 = a
+*/
+bool planFloatingPointAlgebraicIdentity(Instruction &Inst, Rewrite &R) {
+    bool NoSignedZeros = Inst.hasNoSignedZeros();
+
+    for (unsigned i = 0; i < 2; ++i) {
+        std::optional<APFloat> C = getConstantFP(Inst.getOperand(i));
+        if (!C)
+            continue;
+        bool IsIdentity = false;
+
+        switch (Inst.getOpcode()) {
+            case Instruction::FAdd:
+                IsIdentity = C->isNegZero() || (NoSignedZeros && C->isZero());
+                break;
+            case Instruction::FSub:
+                IsIdentity = i == 1 && (C->isPosZero() || (NoSignedZeros && C->isZero()));
+                break;
+            case Instruction::FMul:
+                IsIdentity = C->isExactlyValue(1.0);
+                break;
+            case Instruction::FDiv:
+                IsIdentity = i == 1 && C->isExactlyValue(1.0);
+                break;
+            default:
+                break;
+        }
+
+        if (IsIdentity) {
+            R.Kind = Rewrite::FPAlgebraicIdentity;
+            R.Operand = 1 - i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Funzione che decide la strength reduction per le operazioni floating point:
+ * a / C = a * (1 / C)   se 1 / C e' esatto (C potenza di due) o con arcp
+ * a * 2.0 = a + a
+ * Le nuove istruzioni ereditano i fast-math flag di quella originale
+*/
+bool planFloatingPointStrengthReduction(Instruction &Inst, Rewrite &R) {
+    if (Inst.getOpcode() == Instruction::FDiv) {
+        std::optional<APFloat> C = getConstantFP(Inst.getOperand(1));
+        if (!C)
+            return false;
+
+        APFloat Reciprocal(C->getSemantics());
+        if (!C->getExactInverse(&Reciprocal)) {
+            // Il reciproco arrotondato e' ammesso solo con arcp
+            if (!Inst.hasAllowReciprocal() || !C->isFiniteNonZero())
+                return false;
+            Reciprocal = APFloat(C->getSemantics(), 1);
+            Reciprocal.divide(*C, APFloat::rmNearestTiesToEven);
+        }
+
+        R.Kind = Rewrite::FPReciprocal;
+        R.Reciprocal = Reciprocal;
+        return true;
+    }
+
+    if (Inst.getOpcode() == Instruction::FMul) {
+        for (unsigned i = 0; i < 2; ++i) {
+            std::optional<APFloat> C = getConstantFP(Inst.getOperand(i));
+            if (C && C->isExactlyValue(2.0)) {
+                R.Kind = Rewrite::FPDouble;
+                R.Operand = 1 - i;
+                return true;
             }
         }
     }
@@ -199,59 +1024,500 @@ bool performMultiInstructionOptimization(Instruction &Inst, Instruction::BinaryO
 }
 
 /**
- * Funzione che itera sui basic block
- * e filtra in base al tipo di istruzione
-*/
-bool runOnBasicBlock(BasicBlock &BB) {
-  for (auto &Inst : BB) {
-    // Controllo se l'istruzione è un operatore binario
-    if (auto *BinOp = dyn_cast<BinaryOperator>(&Inst)){
-      // Switch sul tipo di operazione
-      switch (BinOp->getOpcode()) {
-        case Instruction::Add:
-          if (!performAlgebraicIdentity(Inst, Instruction::Add)) {
-              performMultiInstructionOptimization(Inst, Instruction::Add);
-          }
-          break;
-		case Instruction::Sub:
-          if (!performAlgebraicIdentity(Inst, Instruction::Sub)) {
-              performMultiInstructionOptimization(Inst, Instruction::Sub);
-          }
-          break;
-        case Instruction::Mul:
-          if (!performAlgebraicIdentity(Inst, Instruction::Mul)) {
-              performMultiplicationStrengthReduction(Inst);
-          }
-          break;
-        case Instruction::SDiv:
-          performDivisionStrengthReduction(Inst);
-          break;
-
-        default:
-          break;
+ * Fase di analisi per una singola istruzione: filtra in base al tipo
+ * di istruzione e decide la riscrittura senza modificare l'IR.
+ * Puo' girare in parallelo su funzioni diverse: legge le costanti senza
+ * crearne di nuove e non usa il LLVMContext (vedi PlanContext)
+*/
+bool planInstruction(Instruction &Inst, PlanContext &Ctx, Rewrite &R) {
+  // Controllo se l'istruzione è un operatore binario
+  if (auto *BinOp = dyn_cast<BinaryOperator>(&Inst)){
+    // Switch sul tipo di operazione
+    switch (BinOp->getOpcode()) {
+      case Instruction::Add:
+        return planAlgebraicIdentity(Inst, Instruction::Add, R) ||
+               planMultiInstructionOptimization(Inst, Instruction::Add, R) ||
+               planConstantChainFolding(Inst, R);
+      case Instruction::Sub:
+        return planAlgebraicIdentity(Inst, Instruction::Sub, R) ||
+               planMultiInstructionOptimization(Inst, Instruction::Sub, R) ||
+               planConstantChainFolding(Inst, R);
+      case Instruction::Mul:
+        return planAlgebraicIdentity(Inst, Instruction::Mul, R) ||
+               planConstantChainFolding(Inst, R) ||
+               planMultiplicationStrengthReduction(Inst, Ctx, R);
+      case Instruction::Shl:
+        return planConstantChainFolding(Inst, R);
+      case Instruction::SDiv:
+      case Instruction::UDiv:
+      case Instruction::SRem:
+      case Instruction::URem:
+        return planAlgebraicIdentity(Inst, BinOp->getOpcode(), R) ||
+               planDivisionStrengthReduction(Inst, Ctx, R);
+      case Instruction::FAdd:
+      case Instruction::FSub:
+        return planFloatingPointAlgebraicIdentity(Inst, R);
+      case Instruction::FMul:
+      case Instruction::FDiv:
+        return planFloatingPointAlgebraicIdentity(Inst, R) ||
+               planFloatingPointStrengthReduction(Inst, R);
+
+      default:
+        break;
+    }
+  }
+  return false;
+}
+
+/**
+ * Fase di applicazione per una singola istruzione: materializza la riscrittura
+ * decisa da planInstruction, inserendo le nuove istruzioni subito dopo
+ * quella originale. Solo qui vengono create le costanti (shift amount,
+ * magic number, reciproci). Gli operandi vengono letti per indice al momento
+ * dell'applicazione, quindi valgono anche se una riscrittura precedente
+ * li ha sostituiti con un valore equivalente
+*/
+void applyRewrite(Instruction &Inst, const Rewrite &R, OptimizationRemarkEmitter &ORE) {
+  IRBuilder<> Builder(Inst.getNextNode());
+  Type *Ty = Inst.getType();
+  Value *X = Inst.getOperand(R.Operand);
+  Value *Result = nullptr;
+  Statistic *Counter = nullptr;
+  StringRef RemarkName;
+
+  switch (R.Kind) {
+    case Rewrite::AlgebraicIdentity:
+      Result = X;
+      Counter = &NumAlgebraicIdentity;
+      RemarkName = "AlgebraicIdentity";
+      break;
+    case Rewrite::AlgebraicZero:
+      Result = Constant::getNullValue(Ty);
+      Counter = &NumAlgebraicIdentity;
+      RemarkName = "AlgebraicIdentity";
+      break;
+    case Rewrite::MultiInstruction:
+      Result = cast<Instruction>(X)->getOperand(R.SourceOperand);
+      Counter = &NumMultiInstruction;
+      RemarkName = "MultiInstruction";
+      break;
+    case Rewrite::ConstantChain:
+      Result = createAffineChain(Builder, Ty, R.Chain);
+      Counter = &NumConstantChainFolding;
+      RemarkName = "ConstantChainFolding";
+      break;
+    case Rewrite::MulShiftVector: {
+      BinaryOperator *ShiftOp = BinaryOperator::Create(Instruction::Shl, X, createShiftAmounts(Ty, R.ShiftAmounts));
+      ShiftOp->insertAfter(&Inst);
+      Result = ShiftOp;
+      Counter = &NumMulStrengthReduction;
+      RemarkName = "MulStrengthReduction";
+      break;
+    }
+    case Rewrite::MulShiftAddChain:
+      Result = createShiftAddChain(Builder, X, R.Terms, R.NeedsNegation);
+      Counter = &NumMulStrengthReduction;
+      RemarkName = "MulStrengthReduction";
+      break;
+    case Rewrite::NonUniformDivision: {
+      Value *Dividend = Inst.getOperand(0);
+      if (Inst.getOpcode() == Instruction::SDiv || Inst.getOpcode() == Instruction::UDiv) {
+        Result = Builder.CreateLShr(Dividend, createShiftAmounts(Ty, R.ShiftAmounts));
+      } else {
+        // La maschera c - 1 viene calcolata a compile time dal builder
+        Value *Mask = Builder.CreateSub(Inst.getOperand(1), ConstantInt::get(Ty, 1));
+        Result = Builder.CreateAnd(Dividend, Mask);
       }
+      Counter = &NumDivStrengthReduction;
+      RemarkName = "DivStrengthReduction";
+      break;
+    }
+    case Rewrite::Division:
+      Result = createDivision(Builder, Inst.getOperand(0), R.Div);
+      Counter = &NumDivStrengthReduction;
+      RemarkName = "DivStrengthReduction";
+      break;
+    case Rewrite::FPAlgebraicIdentity:
+      Result = X;
+      Counter = &NumFPAlgebraicIdentity;
+      RemarkName = "FPAlgebraicIdentity";
+      break;
+    case Rewrite::FPReciprocal:
+    case Rewrite::FPDouble: {
+      BinaryOperator *NewOp;
+      if (R.Kind == Rewrite::FPReciprocal) {
+        Constant *ReciprocalC = ConstantFP::get(Inst.getContext(), *R.Reciprocal);
+        if (auto *VecTy = dyn_cast<VectorType>(Ty))
+          ReciprocalC = ConstantVector::getSplat(VecTy->getElementCount(), ReciprocalC);
+        NewOp = BinaryOperator::Create(Instruction::FMul, Inst.getOperand(0), ReciprocalC);
+      } else {
+        NewOp = BinaryOperator::Create(Instruction::FAdd, X, X);
+      }
+      NewOp->copyFastMathFlags(&Inst);
+      NewOp->insertAfter(&Inst);
+      Result = NewOp;
+      Counter = &NumFPStrengthReduction;
+      RemarkName = "FPStrengthReduction";
+      break;
     }
   }
-  return true;
+
+  Inst.replaceAllUsesWith(Result);
+  reportRewrite(ORE, *Counter, RemarkName, Inst, Result);
+}
+
+/**
+ * Rimuove un'istruzione diventata morta e rimette in worklist
+ * i suoi operandi, che potrebbero essere diventati morti a loro volta
+*/
+void eraseDeadInstruction(Instruction &Inst, SmallSetVector<Instruction *, 32> &Worklist) {
+  for (Value *Op : Inst.operands())
+    if (auto *OpInst = dyn_cast<Instruction>(Op))
+      Worklist.insert(OpInst);
+
+  Worklist.remove(&Inst);
+  Inst.eraseFromParent();
+  ++NumDeadInstructions;
 }
 
-bool runOnFunction(Function &F) {
+/**
+ * Chiave della tabella delle espressioni disponibili: due istruzioni
+ * sono la stessa espressione se hanno stesso opcode, tipo e operandi
+ * (a meno dell'ordine per le operazioni commutative)
+*/
+struct ExpressionKey {
+    Instruction *Inst;
+
+    // Solo istruzioni senza effetti collaterali e che non leggono memoria
+    static bool canHandle(const Instruction &I) {
+        if (!isa<BinaryOperator>(I) && !isa<CastInst>(I) && !isa<CmpInst>(I) &&
+            !isa<GetElementPtrInst>(I) && !isa<SelectInst>(I))
+            return false;
+        return !I.mayHaveSideEffects() && !I.mayReadFromMemory();
+    }
+};
+
+namespace llvm {
+template <> struct DenseMapInfo<ExpressionKey> {
+    static inline ExpressionKey getEmptyKey() {
+        return {DenseMapInfo<Instruction *>::getEmptyKey()};
+    }
+
+    static inline ExpressionKey getTombstoneKey() {
+        return {DenseMapInfo<Instruction *>::getTombstoneKey()};
+    }
+
+    static unsigned getHashValue(ExpressionKey Key) {
+        Instruction *I = Key.Inst;
+        if (I->isCommutative() && I->getNumOperands() == 2) {
+            Value *LHS = I->getOperand(0);
+            Value *RHS = I->getOperand(1);
+            if (RHS < LHS)
+                std::swap(LHS, RHS);
+            return hash_combine(I->getOpcode(), I->getType(), LHS, RHS);
+        }
+        if (auto *Cmp = dyn_cast<CmpInst>(I))
+            return hash_combine(I->getOpcode(), Cmp->getPredicate(), I->getOperand(0), I->getOperand(1));
+        return hash_combine(I->getOpcode(), I->getType(), hash_combine_range(I->value_op_begin(), I->value_op_end()));
+    }
+
+    static bool isEqual(ExpressionKey LHS, ExpressionKey RHS) {
+        Instruction *L = LHS.Inst;
+        Instruction *R = RHS.Inst;
+        if (L == getEmptyKey().Inst || L == getTombstoneKey().Inst ||
+            R == getEmptyKey().Inst || R == getTombstoneKey().Inst)
+            return L == R;
+        if (L->isIdenticalToWhenDefined(R))
+            return true;
+        // a op b == b op a per le operazioni commutative
+        return L->isCommutative() && L->getNumOperands() == 2 &&
+               L->getOpcode() == R->getOpcode() && L->getType() == R->getType() &&
+               L->getOperand(0) == R->getOperand(1) && L->getOperand(1) == R->getOperand(0);
+    }
+};
+} // namespace llvm
+
+/**
+ * Funzione che esegue la common subexpression elimination su tutta la funzione:
+ * visita in profondita' il dominator tree tenendo una tabella con scope
+ * delle espressioni disponibili. Un'espressione gia' calcolata in un blocco
+ * dominante sostituisce quella ricalcolata; gli usi vengono rimessi in worklist
+*/
+bool eliminateCommonSubexpressions(DominatorTree &DT, SmallSetVector<Instruction *, 32> &Worklist, OptimizationRemarkEmitter &ORE) {
+  using ScopeType = ScopedHashTableScope<ExpressionKey, Instruction *>;
+  ScopedHashTable<ExpressionKey, Instruction *> AvailableExpressions;
   bool Transformed = false;
 
-  for (auto Iter = F.begin(); Iter != F.end(); ++Iter) {
-    if (runOnBasicBlock(*Iter)) {
+  // Lo scope di un nodo resta aperto finche' non sono stati visitati i figli
+  SmallVector<std::pair<DomTreeNode *, std::unique_ptr<ScopeType>>, 32> Stack;
+  Stack.emplace_back(DT.getRootNode(), nullptr);
+
+  while (!Stack.empty()) {
+    if (Stack.back().second) {
+      Stack.pop_back();
+      continue;
+    }
+
+    DomTreeNode *Node = Stack.back().first;
+    Stack.back().second = std::make_unique<ScopeType>(AvailableExpressions);
+
+    for (Instruction &Inst : make_early_inc_range(*Node->getBlock())) {
+      if (!ExpressionKey::canHandle(Inst))
+        continue;
+
+      Instruction *Available = AvailableExpressions.lookup({&Inst});
+      if (!Available) {
+        AvailableExpressions.insert({&Inst}, &Inst);
+        continue;
+      }
+
+      // I flag (nsw, exact, fast-math...) validi per entrambe
+      Available->andIRFlags(&Inst);
+      for (User *U : Inst.users())
+        if (auto *UserInst = dyn_cast<Instruction>(U))
+          Worklist.insert(UserInst);
+      Inst.replaceAllUsesWith(Available);
+      reportRewrite(ORE, NumCommonSubexpression, "CommonSubexpression", Inst, Available);
+      Worklist.remove(&Inst);
+      Inst.eraseFromParent();
       Transformed = true;
     }
+
+    for (DomTreeNode *Child : Node->children())
+      Stack.emplace_back(Child, nullptr);
   }
 
   return Transformed;
 }
 
+/**
+ * Piano di riscrittura di una funzione, costruito dalla fase di analisi
+ * parallela: contiene le riscritture gia' decise, le istruzioni da cui
+ * parte la worklist e dice se ci sono espressioni ripetute per la CSE
+*/
+struct RewritePlan {
+  // Istruzioni con una riscrittura decisa o banalmente morte, in ordine di programma
+  std::vector<Instruction *> Candidates;
+  DenseMap<Instruction *, Rewrite> Rewrites;
+  // Istruzioni lette da una decisione oltre agli operandi diretti (gli anelli
+  // di una catena di costanti e la sua base): se cambiano, la decisione va rifatta
+  DenseMap<Instruction *, SmallVector<Instruction *, 2>> Dependents;
+  bool HasRepeatedExpressions = false;
+
+  bool empty() const { return Candidates.empty() && !HasRepeatedExpressions; }
+};
+
+/**
+ * Fase di analisi: costruisce il piano di una funzione leggendo soltanto l'IR,
+ * quindi puo' girare in parallelo su funzioni diverse. Per ogni istruzione
+ * planInstruction sceglie la riscrittura e ne calcola le costanti; le
+ * istruzioni la cui decisione e' stata rimandata restano tra i candidati
+ * senza riscrittura e vengono analizzate dalla fase di applicazione
+*/
+RewritePlan buildRewritePlan(Function &F, PlanContext &Ctx) {
+  RewritePlan Plan;
+  DenseSet<ExpressionKey> Expressions;
+  Ctx.IsScan = true;
+
+  for (BasicBlock &BB : F) {
+    for (Instruction &Inst : BB) {
+      if (ExpressionKey::canHandle(Inst) && !Expressions.insert({&Inst}).second)
+        Plan.HasRepeatedExpressions = true;
+
+      if (Inst.use_empty() && !Inst.isTerminator() && !Inst.mayHaveSideEffects()) {
+        Plan.Candidates.push_back(&Inst);
+        continue;
+      }
+
+      Rewrite R;
+      if (!planInstruction(Inst, Ctx, R)) {
+        if (Ctx.IsDeferred)
+          Plan.Candidates.push_back(&Inst);
+        Ctx.IsDeferred = false;
+        continue;
+      }
+
+      if (R.Kind == Rewrite::ConstantChain) {
+        for (Instruction *Link : drop_begin(R.Chain.Links))
+          Plan.Dependents[Link].push_back(&Inst);
+        if (auto *BaseInst = dyn_cast<Instruction>(R.Chain.Base))
+          Plan.Dependents[BaseInst].push_back(&Inst);
+      }
+      Plan.Rewrites.try_emplace(&Inst, std::move(R));
+      Plan.Candidates.push_back(&Inst);
+    }
+  }
 
+  Ctx.IsScan = false;
+  return Plan;
+}
+
+/**
+ * Funzione che applica il piano su tutta la funzione con una worklist
+ * che parte dai candidati, fino a punto fisso:
+ * - le istruzioni banalmente morte vengono rimosse
+ * - le riscritture decise dalla fase di analisi vengono solo materializzate;
+ *   una decisione viene scartata quando cambia un'istruzione che ha letto
+ *   e l'istruzione viene rianalizzata
+ * - dopo ogni riscrittura vengono rimessi in worklist gli usi
+ *   dell'istruzione riscritta e le nuove istruzioni create,
+ *   cosi' le riscritture rese possibili da una sostituzione vengono provate
+ * - quando la worklist si svuota, la CSE sul dominator tree elimina le
+ *   espressioni ridondanti tra blocchi e rimette in worklist i loro usi
+*/
+bool runOnFunction(RewritePlan &Plan, PlanContext &Ctx, DominatorTree &DT, OptimizationRemarkEmitter &ORE) {
+  bool Transformed = false;
+  SmallSetVector<Instruction *, 32> Worklist;
+
+  // Inserisco in ordine inverso, cosi' le istruzioni vengono estratte in ordine
+  for (Instruction *Inst : reverse(Plan.Candidates))
+    Worklist.insert(Inst);
+
+  // Scarta le decisioni che hanno letto Changed: quelle dei suoi usi
+  // e quelle delle catene di costanti che lo attraversano
+  auto DropDependentRewrites = [&Plan](Instruction *Changed) {
+    for (User *U : Changed->users())
+      if (auto *UserInst = dyn_cast<Instruction>(U))
+        Plan.Rewrites.erase(UserInst);
+    auto It = Plan.Dependents.find(Changed);
+    if (It == Plan.Dependents.end())
+      return;
+    for (Instruction *Dependent : It->second)
+      Plan.Rewrites.erase(Dependent);
+    Plan.Dependents.erase(It);
+  };
+
+  bool Eliminated;
+  do {
+    while (!Worklist.empty()) {
+      Instruction *Inst = Worklist.pop_back_val();
+
+      if (isInstructionTriviallyDead(Inst)) {
+        DropDependentRewrites(Inst);
+        Plan.Rewrites.erase(Inst);
+        eraseDeadInstruction(*Inst, Worklist);
+        Transformed = true;
+        continue;
+      }
+
+      // La decisione della fase di analisi, se e' ancora valida;
+      // altrimenti l'istruzione e' cambiata dopo l'analisi e va rianalizzata
+      Rewrite R;
+      auto Planned = Plan.Rewrites.find(Inst);
+      if (Planned != Plan.Rewrites.end()) {
+        R = std::move(Planned->second);
+        Plan.Rewrites.erase(Planned);
+      } else if (!planInstruction(*Inst, Ctx, R)) {
+        continue;
+      }
+
+      // Gli usi vanno salvati prima della riscrittura, dopo passano al rimpiazzo
+      SmallVector<Instruction *, 8> Users;
+      for (User *U : Inst->users())
+        if (auto *UserInst = dyn_cast<Instruction>(U))
+          Users.push_back(UserInst);
+      Instruction *Next = Inst->getNextNode();
+
+      DropDependentRewrites(Inst);
+      applyRewrite(*Inst, R, ORE);
+      Transformed = true;
+
+      // Le istruzioni create dalla riscrittura stanno tra Inst e Next
+      for (Instruction *New = Inst->getNextNode(); New && New != Next; New = New->getNextNode())
+        Worklist.insert(New);
+      for (Instruction *UserInst : Users)
+        Worklist.insert(UserInst);
+      if (Inst->use_empty())
+        Worklist.insert(Inst);
+    }
+
+    // A worklist vuota le decisioni del piano sono state tutte consumate:
+    // la CSE lavora sull'IR gia' riscritto e non ha bisogno del piano
+    Plan.Rewrites.clear();
+    Plan.Dependents.clear();
+    Eliminated = eliminateCommonSubexpressions(DT, Worklist, ORE);
+    Transformed |= Eliminated;
+  } while (Eliminated);
+
+  return Transformed;
+}
+
+
+/**
+ * Il pass e' diviso in due fasi:
+ * - analisi: un thread pool costruisce in parallelo il piano di ogni funzione,
+ *   decidendo gia' le riscritture (known bits, magic number, costi del target)
+ * - applicazione: le funzioni con un piano non vuoto vengono ottimizzate
+ *   in serie, e solo le loro analisi vengono invalidate
+*/
 PreservedAnalyses LocalOpts::run(Module &M, ModuleAnalysisManager &AM) {
-  for (auto Fiter = M.begin(); Fiter != M.end(); ++Fiter)
-    if (runOnFunction(*Fiter))
-      return PreservedAnalyses::none();
-  
-  return PreservedAnalyses::all();
+  TimeTraceScope TimeScope("LocalOpts", M.getName());
+  FunctionAnalysisManager &FAM = AM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+
+  std::vector<Function *> Functions;
+  for (Function &F : M)
+    if (!F.isDeclaration())
+      Functions.push_back(&F);
+
+  // L'analysis manager e il LLVMContext non sono thread-safe: prima del thread pool
+  // si chiedono il TargetTransformInfo e i costi delle moltiplicazioni, e si
+  // creano i layout delle struct, che il DataLayout altrimenti crea alla prima
+  // richiesta (computeKnownBits li legge per i getelementptr)
+  const DataLayout &DL = M.getDataLayout();
+  TypeFinder StructTypes;
+  StructTypes.run(M, false);
+  for (StructType *STy : StructTypes)
+    if (STy->isSized())
+      DL.getStructLayout(STy);
+
+  std::vector<PlanContext> Contexts;
+  Contexts.reserve(Functions.size());
+  for (Function *F : Functions) {
+    Contexts.emplace_back(FAM.getResult<TargetIRAnalysis>(*F), DL);
+    computeMulCostModels(*F, Contexts.back());
+  }
+
+  // Fase di analisi: ogni thread legge un blocco di funzioni e scrive solo i loro
+  // piani e i loro contesti, senza lock
+  std::vector<RewritePlan> Plans(Functions.size());
+  {
+    TimeTraceScope ScanScope("LocalOpts scan");
+    ThreadPool Pool(hardware_concurrency(LocalOptsThreads));
+    size_t BatchSize = std::max(1u, PlanBatchSize.getValue());
+    for (size_t Begin = 0; Begin < Functions.size(); Begin += BatchSize) {
+      size_t End = std::min(Begin + BatchSize, Functions.size());
+      Pool.async([&Functions, &Contexts, &Plans, Begin, End] {
+        for (size_t i = Begin; i != End; ++i)
+          Plans[i] = buildRewritePlan(*Functions[i], Contexts[i]);
+      });
+    }
+    Pool.wait();
+  }
+
+  // Fase di applicazione: il CFG non cambia mai, le analisi sul CFG restano valide
+  PreservedAnalyses FunctionPA;
+  FunctionPA.preserveSet<CFGAnalyses>();
+  bool Transformed = false;
+
+  for (size_t i = 0; i != Functions.size(); ++i) {
+    if (Plans[i].empty())
+      continue;
+
+    Function &F = *Functions[i];
+    TimeTraceScope ApplyScope("LocalOpts apply", F.getName());
+    if (runOnFunction(Plans[i], Contexts[i], FAM.getResult<DominatorTreeAnalysis>(F),
+                      FAM.getResult<OptimizationRemarkEmitterAnalysis>(F))) {
+      FAM.invalidate(F, FunctionPA);
+      Transformed = true;
+    }
+  }
+
+  if (!Transformed)
+    return PreservedAnalyses::all();
+
+  // Le analisi delle funzioni modificate sono gia' state invalidate una per una
+  PreservedAnalyses PA;
+  PA.preserveSet<AllAnalysesOn<Function>>();
+  PA.preserve<FunctionAnalysisManagerModuleProxy>();
+  return PA;
 }
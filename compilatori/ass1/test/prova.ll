@@ -1,3 +1,19 @@
+; RUN: opt -passes=localopts -S %s | FileCheck %s
+; La fase di analisi in parallelo, con una funzione per task, deve dare
+; lo stesso risultato di quella seriale
+; RUN: opt -passes=localopts -localopts-threads=1 -S %s -o %t.serial.ll
+; RUN: opt -passes=localopts -localopts-threads=4 -localopts-batch-size=1 -S %s -o %t.parallel.ll
+; RUN: diff %t.serial.ll %t.parallel.ll
+;
+; Ogni riscrittura emette un remark con il suo tipo
+; RUN: opt -passes=localopts -pass-remarks-output=%t.yaml -disable-output %s
+; RUN: FileCheck --check-prefix=REMARK %s < %t.yaml
+; REMARK:      --- !Passed
+; REMARK-NEXT: Pass:            localopts
+; REMARK-NEXT: Name:            AlgebraicIdentity
+; REMARK-NEXT: Function:        example_function
+; REMARK:      Function:        division_function
+
 define void @example_function(i32* %a, i32* %b, i32* %c, i32* %d, i32* %e, i32* %f, i32* %g, i32* %h, i32* %i, i32* %l, i32* %m, i32* %n, i32* %o) {
 entry:
   ; a = a + 0
@@ -59,3 +75,237 @@ entry:
 }
 
 
+
+define void @division_function(i32* %a, i32* %b, i32* %c, i32* %d, i32* %e) {
+entry:
+  ; a = a / 10
+  %0 = load i32, i32* %a
+  %1 = sdiv i32 %0, 10
+  store i32 %1, i32* %a
+
+  ; b = b / 7 (unsigned)
+  %2 = load i32, i32* %b
+  %3 = udiv i32 %2, 7
+  store i32 %3, i32* %b
+
+  ; c = c % 1000
+  %4 = load i32, i32* %c
+  %5 = srem i32 %4, 1000
+  store i32 %5, i32* %c
+
+  ; d = d % 10 (unsigned)
+  %6 = load i32, i32* %d
+  %7 = urem i32 %6, 10
+  store i32 %7, i32* %d
+
+  ; e = e / -8
+  %8 = load i32, i32* %e
+  %9 = sdiv i32 %8, -8
+  store i32 %9, i32* %e
+
+  ret void
+}
+
+define void @multiplication_function(i32* %a, i32* %b, i32* %c) {
+entry:
+  ; a = a * 10
+  %0 = load i32, i32* %a
+  %1 = mul i32 %0, 10
+  store i32 %1, i32* %a
+
+  ; b = b * 24
+  %2 = load i32, i32* %b
+  %3 = mul i32 %2, 24
+  store i32 %3, i32* %b
+
+  ; c = c * 100
+  %4 = load i32, i32* %c
+  %5 = mul i32 %4, 100
+  store i32 %5, i32* %c
+
+  ret void
+}
+
+define void @known_bits_function(i32* %a, i32* %b, i32* %c, i32* %d) {
+entry:
+  ; a = (a & 255) / 16: dividendo non negativo
+  %0 = load i32, i32* %a
+  %1 = and i32 %0, 255
+  %2 = sdiv i32 %1, 16
+  store i32 %2, i32* %a
+
+  ; b = (b & 255) % 16: dividendo non negativo
+  %3 = load i32, i32* %b
+  %4 = and i32 %3, 255
+  %5 = srem i32 %4, 16
+  store i32 %5, i32* %b
+
+  ; c = c / 32 (unsigned)
+  %6 = load i32, i32* %c
+  %7 = udiv i32 %6, 32
+  store i32 %7, i32* %c
+
+  ; d = d % 32 (unsigned)
+  %8 = load i32, i32* %d
+  %9 = urem i32 %8, 32
+  store i32 %9, i32* %d
+
+  ret void
+}
+
+define void @vector_function(<4 x i32>* %a, <4 x i32>* %b, <4 x i32>* %c, <4 x i32>* %d) {
+entry:
+  ; a = (a + 0) * 8
+  %0 = load <4 x i32>, <4 x i32>* %a
+  %1 = add <4 x i32> %0, zeroinitializer
+  %2 = mul <4 x i32> %1, <i32 8, i32 8, i32 8, i32 8>
+  store <4 x i32> %2, <4 x i32>* %a
+
+  ; b = b * <1, 2, 4, 8>
+  %3 = load <4 x i32>, <4 x i32>* %b
+  %4 = mul <4 x i32> %3, <i32 1, i32 2, i32 4, i32 8>
+  store <4 x i32> %4, <4 x i32>* %b
+
+  ; c = c / 10
+  %5 = load <4 x i32>, <4 x i32>* %c
+  %6 = sdiv <4 x i32> %5, <i32 10, i32 10, i32 10, i32 10>
+  store <4 x i32> %6, <4 x i32>* %c
+
+  ; d = d % <2, 4, 8, 16> (unsigned)
+  %7 = load <4 x i32>, <4 x i32>* %d
+  %8 = urem <4 x i32> %7, <i32 2, i32 4, i32 8, i32 16>
+  store <4 x i32> %8, <4 x i32>* %d
+
+  ret void
+}
+
+define void @floating_point_function(double* %a, double* %b, double* %c, double* %d, double* %e) {
+entry:
+  ; a = a + (-0.0)
+  %0 = load double, double* %a
+  %1 = fadd double %0, -0.0
+  store double %1, double* %a
+
+  ; b = b * 1.0 + 0.0 (nsz)
+  %2 = load double, double* %b
+  %3 = fmul double %2, 1.0
+  %4 = fadd nsz double %3, 0.0
+  store double %4, double* %b
+
+  ; c = c / 8.0
+  %5 = load double, double* %c
+  %6 = fdiv double %5, 8.0
+  store double %6, double* %c
+
+  ; d = d / 10.0 (arcp)
+  %7 = load double, double* %d
+  %8 = fdiv arcp double %7, 10.0
+  store double %8, double* %d
+
+  ; e = e * 2.0
+  %9 = load double, double* %e
+  %10 = fmul double %9, 2.0
+  store double %10, double* %e
+
+  ret void
+}
+
+define void @chain_function(i32* %a, i32* %b, i32* %c) {
+entry:
+  ; a = ((a + 3) - 5) * 4
+  %0 = load i32, i32* %a
+  %1 = add i32 %0, 3
+  %2 = sub i32 %1, 5
+  %3 = mul i32 %2, 4
+  store i32 %3, i32* %a
+
+  ; b = (b + 1) + 2 + 3 (nsw)
+  %4 = load i32, i32* %b
+  %5 = add nsw i32 %4, 1
+  %6 = add nsw i32 %5, 2
+  %7 = add nsw i32 %6, 3
+  store i32 %7, i32* %b
+
+  ; c = (c * 3) << 2
+  %8 = load i32, i32* %c
+  %9 = mul i32 %8, 3
+  %10 = shl i32 %9, 2
+  store i32 %10, i32* %c
+
+  ret void
+}
+
+define i32 @cse_function(i32 %x, i32 %y, i1 %c) {
+entry:
+  ; a = x * 8, b = x + y
+  %0 = mul i32 %x, 8
+  %1 = add i32 %x, %y
+  br i1 %c, label %then, label %else
+
+then:
+  ; ricalcolati in un blocco dominato: a = x << 3, b = y + x
+  %2 = shl i32 %x, 3
+  %3 = add i32 %y, %x
+  %4 = add i32 %2, %3
+  br label %join
+
+else:
+  %5 = mul i32 %x, 8
+  %6 = add i32 %5, %1
+  br label %join
+
+join:
+  %7 = phi i32 [ %4, %then ], [ %6, %else ]
+  %8 = add i32 %7, %0
+  ret i32 %8
+}
+
+; Divisioni e resti per 1: il quoziente vale il dividendo, il resto vale 0
+; CHECK-LABEL: define void @division_by_one_function(
+; CHECK-NEXT:  entry:
+; CHECK-NEXT:    [[A:%.*]] = load i32, ptr %a
+; CHECK-NEXT:    store i32 [[A]], ptr %a
+; CHECK-NEXT:    store i32 0, ptr %b
+; CHECK-NEXT:    store i32 0, ptr %c
+; CHECK-NEXT:    ret void
+define void @division_by_one_function(i32* %a, i32* %b, i32* %c) {
+entry:
+  ; a = a / 1 (unsigned)
+  %0 = load i32, i32* %a
+  %1 = udiv i32 %0, 1
+  store i32 %1, i32* %a
+
+  ; b = b % 1
+  %2 = load i32, i32* %b
+  %3 = srem i32 %2, 1
+  store i32 %3, i32* %b
+
+  ; c = c % 1 (unsigned)
+  %4 = load i32, i32* %c
+  %5 = urem i32 %4, 1
+  store i32 %5, i32* %c
+
+  ret void
+}
+
+; Un anello della catena con altri usi non viene assorbito: resterebbe vivo
+; e la catena riscritta non farebbe risparmiare istruzioni
+; CHECK-LABEL: define void @chain_shared_function(
+; CHECK-NEXT:  entry:
+; CHECK-NEXT:    [[A:%.*]] = load i32, ptr %a
+; CHECK-NEXT:    [[T:%.*]] = add i32 [[A]], 3
+; CHECK-NEXT:    [[U:%.*]] = add i32 [[T]], 5
+; CHECK-NEXT:    store i32 [[U]], ptr %a
+; CHECK-NEXT:    store i32 [[T]], ptr %b
+; CHECK-NEXT:    ret void
+define void @chain_shared_function(i32* %a, i32* %b) {
+entry:
+  ; t = a + 3, a = t + 5, b = t
+  %0 = load i32, i32* %a
+  %1 = add i32 %0, 3
+  %2 = add i32 %1, 5
+  store i32 %2, i32* %a
+  store i32 %1, i32* %b
+
+  ret void
+}
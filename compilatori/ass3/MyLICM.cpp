@@ -6,44 +6,121 @@
 // Poi aggiungere il passo LOOP_PASS("MyLICM", MyLICM())
 // in llvm/lib/Passes/PassRegistry.def
 //
-// Ricordarsi di guardare MyLICM.h e aggiungere anche quel file
+// Il file MyLICM.h in questa cartella va copiato in
+// llvm/include/llvm/Transforms/Utils
 //
 //===----------------------------------------------------------------------===//
 
 #include "llvm/Transforms/Utils/MyLICM.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/CaptureTracking.h"
+#include "llvm/Analysis/DomTreeUpdater.h"
+#include "llvm/Analysis/InstructionSimplify.h"
+#include "llvm/Analysis/Loads.h"
+#include "llvm/Analysis/LoopIterator.h"
+#include "llvm/Analysis/MemorySSA.h"
+#include "llvm/Analysis/MemorySSAUpdater.h"
+#include "llvm/Analysis/MustExecute.h"
+#include "llvm/Analysis/OptimizationRemarkEmitter.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include "llvm/Transforms/Utils/LoopRotationUtils.h"
+#include "llvm/Transforms/Utils/LoopUtils.h"
+#include "llvm/Transforms/Utils/SSAUpdater.h"
+#include <optional>
 
 using namespace llvm;
 
+#define DEBUG_TYPE "mylicm"
 
+STATISTIC(NumHoisted, "Number of instructions hoisted to the preheader");
+STATISTIC(NumErased, "Number of invariant instructions without uses erased");
+STATISTIC(NumHoistedOuter, "Number of instructions hoisted to the preheader of an outer loop");
+STATISTIC(NumHoistedLoads, "Number of loads hoisted to the preheader");
+STATISTIC(NumHoistedCalls, "Number of readnone and readonly calls hoisted to the preheader");
+STATISTIC(NumNotHoistedPressure, "Number of hoistable instructions left in the loop because of register pressure");
+STATISTIC(NumNoPreheader, "Number of loops skipped because they have no preheader");
+STATISTIC(NumPreheaders, "Number of preheaders inserted");
+STATISTIC(NumRotated, "Number of loops rotated to do-while form before hoisting");
+STATISTIC(NumUnswitched, "Number of loops unswitched on an invariant condition");
+STATISTIC(NumDeletedLoops, "Number of inner loops deleted because unswitching made them unreachable");
+STATISTIC(NumPromoted, "Number of memory locations promoted to registers");
 
-//marco
-void MyLICM::markInstruction(Instruction &Inst, int InstructionOrder) {
-	LLVMContext &Ctx = Inst.getContext();
-	MDNode *N = MDNode::get(Ctx, MDString::get(Ctx, std::to_string(InstructionOrder)));
-	Inst.setMetadata("licm.candidate", N);
-}
+// Limite di registri vivi per classe usato dal modello di costo dello hoisting
+// (0 = numero di registri della classe nel target)
+static cl::opt<unsigned> MaxRegisterPressure(
+    "mylicm-max-pressure", cl::init(0),
+    cl::desc("Maximum estimated live registers per class in a loop after hoisting (0 = target register count)"));
 
-//demarco
-void MyLICM::removeMarking(Instruction &Inst){
-	
-	Inst.setMetadata("licm.candidate", NULL);
-}
+// Rotazione in forma do-while dei loop in cui lo hoisting è bloccato dalle uscite
+static cl::opt<bool> EnableRotation(
+    "mylicm-rotate", cl::init(true),
+    cl::desc("Rotate loops to do-while form when invariant instructions do not execute before the exits"));
+
+// Numero massimo di istruzioni dell'header duplicate nel preheader dalla rotazione
+static cl::opt<unsigned> RotationMaxHeaderSize(
+    "mylicm-rotate-max-header-size", cl::init(16),
+    cl::desc("Maximum size of a loop header duplicated by the rotation"));
+
+// Promozione in registro delle locazioni lette e scritte a ogni iterazione
+static cl::opt<bool> EnablePromotion(
+    "mylicm-promote", cl::init(true),
+    cl::desc("Promote memory locations loaded and stored in the loop to registers"));
+
+// Unswitching delle condizioni invarianti di branch e select
+static cl::opt<bool> EnableUnswitch(
+    "mylicm-unswitch", cl::init(true),
+    cl::desc("Unswitch loops on loop-invariant branch and select conditions"));
+
+// Budget di code size (costo TTI) del loop moltiplicato per le copie dopo l'unswitching
+static cl::opt<int> UnswitchThreshold(
+    "mylicm-unswitch-threshold", cl::init(200),
+    cl::desc("Maximum code size of a loop times the number of its copies after unswitching"));
 
-//test marcatura
-bool MyLICM::isInstructionMarked(const Instruction &Inst) {
 
-	return Inst.getMetadata("licm.candidate") ? true : false;
-}
+
+namespace {
+
+// Istruzioni invarianti di un loop.
+// L'appartenenza all'insieme sostituisce la marcatura con metadati:
+// non si creano MDString nel LLVMContext e non resta nulla sull'IR.
+class LoopInvariants {
+	Loop &L;
+	LoopStandardAnalysisResults &LAR;
+	SmallPtrSet<const Instruction *, 32> Invariant;
+
+public:
+	LoopInvariants(Loop &L, LoopStandardAnalysisResults &LAR) : L(L), LAR(LAR) {}
+
+	bool contains(const Instruction &Inst) const { return Invariant.count(&Inst); }
+	void erase(const Instruction &Inst) { Invariant.erase(&Inst); }
+
+	bool isOperandInvariant(const Use &Usee) const;
+	bool isLoadInvariant(const LoadInst &Load) const;
+	bool isCallInvariant(const CallBase &Call) const;
+	bool isInstructionInvariant(const Instruction &Inst) const;
+	void compute();
+};
+
+} // namespace
 
 
 // Se un operando è costante, argomento di funzione o riferimento a istruzione
 // già invariante, allora è invariante.
-bool MyLICM::isOperandInvariant(const Use &Usee, Loop &L) {
+bool LoopInvariants::isOperandInvariant(const Use &Usee) const {
 	if (isa<Constant>(Usee) || isa<Argument>(Usee)) return true;
 
 	if (auto *Inst = dyn_cast<Instruction>(Usee)) {
 		
-		if (isInstructionMarked(*Inst)) return true;
+		if (contains(*Inst)) return true;
 		if (!L.contains(Inst)) return true;
 	}
 
@@ -52,114 +129,1017 @@ bool MyLICM::isOperandInvariant(const Use &Usee, Loop &L) {
 }
 
 
+// Vero se qualche istruzione del loop può scrivere la memoria letta da Reader,
+// una load o una chiamata readonly.
+// Con MemorySSA (loop-mssa) si guarda il clobber di Reader: deve stare fuori dal loop.
+// Senza MemorySSA si interroga AA su ogni istruzione del loop che scrive in memoria.
+static bool isClobberedInLoop(const Instruction &Reader, const Loop &L, LoopStandardAnalysisResults &LAR) {
+	if (MemorySSA *MSSA = LAR.MSSA) {
+		MemoryAccess *Clobber = MSSA->getWalker()->getClobberingMemoryAccess(const_cast<Instruction *>(&Reader));
+		return !MSSA->isLiveOnEntryDef(Clobber) && L.contains(Clobber->getBlock());
+	}
+
+	auto *Call = dyn_cast<CallBase>(&Reader);
+	std::optional<MemoryLocation> Loc;
+	if (!Call) Loc = MemoryLocation::get(&Reader);
+	for (auto *BB : L.getBlocks()) {
+		for (auto &Inst : *BB) {
+			if (!Inst.mayWriteToMemory()) continue;
+			ModRefInfo MRI = Call ? LAR.AA.getModRefInfo(&Inst, Call) : LAR.AA.getModRefInfo(&Inst, Loc);
+			if (isModSet(MRI)) return true;
+		}
+	}
+
+	return false;
+}
+
+// Una load è invariante se il suo indirizzo è invariante e nessuna istruzione
+// del loop può scrivere la locazione letta.
+bool LoopInvariants::isLoadInvariant(const LoadInst &Load) const {
+	// volatile e atomiche restano dove sono
+	if (!Load.isUnordered()) return false;
+	if (!isOperandInvariant(Load.getOperandUse(LoadInst::getPointerOperandIndex()))) return false;
+
+	return !isClobberedInLoop(Load, L, LAR);
+}
+
+
+// Una chiamata è invariante se non scrive memoria, termina sempre senza lanciare
+// eccezioni (nounwind, willreturn), non è convergent e ha argomenti invarianti.
+// Così sono candidate le funzioni readnone/memory(none) come sqrt e gli helper pure;
+// se la chiamata legge memoria (readonly, come strlen) nessuna istruzione del loop
+// deve scrivere ciò che legge.
+// Intrinseci di debug, inline asm e chiamate con operand bundle restano dove sono.
+bool LoopInvariants::isCallInvariant(const CallBase &Call) const {
+	if (isa<DbgInfoIntrinsic>(Call) || Call.isInlineAsm() || Call.hasOperandBundles()) return false;
+	if (!Call.onlyReadsMemory() || !Call.doesNotThrow() || !Call.willReturn() || Call.isConvergent()) return false;
+	if (!all_of(Call.operands(), [&](const Use &Usee) { return isOperandInvariant(Usee); })) return false;
+
+	return !Call.mayReadFromMemory() || !isClobberedInLoop(Call, L, LAR);
+}
+
+
 //se ha tutti gli operandi invarianti 
 // Le PHI non possono essere invarianti.
-bool MyLICM::isInstructionInvariant(const Instruction &Inst,Loop &L) {
+// Store e istruzioni con effetti collaterali non sono mai invarianti,
+// load e chiamate lo sono solo se isLoadInvariant e isCallInvariant lo dimostrano.
+bool LoopInvariants::isInstructionInvariant(const Instruction &Inst) const {
 
 	if (isa<PHINode>(Inst)) return false;
+	if (Inst.isTerminator() || Inst.isEHPad() || isa<AllocaInst>(Inst)) return false;
+	if (auto *Load = dyn_cast<LoadInst>(&Inst)) return isLoadInvariant(*Load);
+	if (auto *Call = dyn_cast<CallBase>(&Inst)) return isCallInvariant(*Call);
+	if (Inst.mayHaveSideEffects() || Inst.mayReadFromMemory()) return false;
+
+	return all_of(Inst.operands(), [&](const Use &Usee) { return isOperandInvariant(Usee); });
+}
+
+// Ricerca delle invarianti fino al punto fisso.
+// I blocchi vengono visitati in reverse post-order, così gli operandi (PHI escluse)
+// si vedono prima degli usi. Quando un'istruzione diventa invariante i suoi utenti
+// nel loop tornano nel worklist: possono esserlo diventati anche loro, anche se
+// stanno prima nell'ordine dei blocchi.
+void LoopInvariants::compute() {
+	// si può ricalcolare dopo aver cambiato la forma del loop (rotazione)
+	Invariant.clear();
+	SmallVector<const Instruction *, 32> Worklist;
+	auto Visit = [&](const Instruction &Inst) {
+		if (contains(Inst) || !isInstructionInvariant(Inst)) return;
+		Invariant.insert(&Inst);
+		for (auto *User : Inst.users()) {
+			auto *UserInst = cast<Instruction>(User);
+			if (L.contains(UserInst) && !contains(*UserInst)) Worklist.push_back(UserInst);
+		}
+	};
 
+	LoopBlocksRPO RPOT(&L);
+	RPOT.perform(&LAR.LI);
+	for (auto *BB : RPOT) {
+		for (auto &Inst : *BB) Visit(Inst);
+	}
+	while (!Worklist.empty()) Visit(*Worklist.pop_back_val());
+}
+
+
+// Loop più esterno nel cui preheader si può spostare un'istruzione hoistable da L.
+// Si risale il nido finché:
+// - nessun operando sta nel loop esterno (gli operandi invarianti sono già stati
+//   spostati, nel preheader più esterno possibile, perché si procede in RPO);
+// - una load o una chiamata readonly non legge nulla scritto nel loop esterno;
+// - l'istruzione è eseguita a ogni iterazione del loop esterno prima di ogni sua
+//   uscita, oppure può essere eseguita speculativamente.
+// La destinazione dipende solo dal nido e non dall'ordine in cui i loop vengono
+// visitati: visitare poi i loop esterni non sposta più nulla di quanto spostato qui.
+// OuterSafety tiene le informazioni sulle eccezioni dei loop esterni per tutta la
+// chiamata di hoistInvariants: spostare un'istruzione dal loop interno non le invalida,
+// perché il controllo riguarda la sua posizione originale, fuori dagli header esterni.
+static Loop *getOutermostHoistTarget(Instruction &I, Loop &L, LoopStandardAnalysisResults &LAR,
+                                     DenseMap<Loop *, std::unique_ptr<SimpleLoopSafetyInfo>> &OuterSafety) {
+	Loop *Target = &L;
+	for (Loop *Outer = L.getParentLoop(); Outer && Outer->getLoopPreheader(); Outer = Outer->getParentLoop()) {
+		if (any_of(I.operands(), [&](const Use &U) {
+			    auto *Op = dyn_cast<Instruction>(U);
+			    return Op && Outer->contains(Op);
+		    }))
+			break;
 
-	bool invariantFlag = true;
+		if (I.mayReadFromMemory() && isClobberedInLoop(I, *Outer, LAR)) break;
 
-	for (const auto &Usee : Inst.operands()) {
-		if (!isOperandInvariant(Usee, L)) invariantFlag = false;
+		std::unique_ptr<SimpleLoopSafetyInfo> &SafetyInfo = OuterSafety[Outer];
+		if (!SafetyInfo) {
+			SafetyInfo = std::make_unique<SimpleLoopSafetyInfo>();
+			SafetyInfo->computeLoopSafetyInfo(Outer);
+		}
+		if (!isSafeToSpeculativelyExecute(&I) && !SafetyInfo->isGuaranteedToExecute(I, &LAR.DT, Outer)) break;
+
+		Target = Outer;
 	}
+	return Target;
+}
 
-	return invariantFlag;
+
+// Classe di registri TTI di un tipo, nessuna per i tipi che non occupano registri.
+static std::optional<unsigned> getRegisterClass(const TargetTransformInfo &TTI, Type *Ty) {
+	if (!Ty->isIntOrIntVectorTy() && !Ty->isPtrOrPtrVectorTy() && !Ty->isFPOrFPVectorTy()) return std::nullopt;
+	return TTI.getRegisterClassForType(Ty->isVectorTy(), Ty);
 }
 
-//marcatura quelle invarianti
-// La variabile i è utile per debug: nel metadato resta l'ordine di discovery.
+namespace {
+
+// Registri usati da un loop, per classe TTI.
+// Non è un'analisi di liveness completa: conta i valori vivi attraverso tutto il loop
+// (definiti fuori e usati dentro, PHI dell'header) e a parte il picco di valori
+// vivi dentro un singolo blocco, calcolato scorrendo il blocco all'indietro.
+struct RegisterUsage {
+	// valori definiti fuori dal loop e usati dentro: occupano un registro per tutto il loop
+	SmallPtrSet<const Value *, 32> LiveIns;
+	// PHI dell'header
+	DenseMap<unsigned, unsigned> Through;
+	DenseMap<unsigned, unsigned> Peak;
+};
+
+} // namespace
+
+static RegisterUsage computeRegisterUsage(const Loop &L, const TargetTransformInfo &TTI) {
+	RegisterUsage Usage;
+	// le PHI dell'header sono vive per tutto il loop: si contano una volta sola
+	// qui sotto, e non nel picco dei blocchi
+	auto isHeaderPhi = [&](const Value *V) {
+		return isa<PHINode>(V) && cast<PHINode>(V)->getParent() == L.getHeader();
+	};
+	for (auto &Phi : L.getHeader()->phis()) {
+		if (auto ClassID = getRegisterClass(TTI, Phi.getType())) ++Usage.Through[*ClassID];
+	}
 
-void MyLICM::checkForInvariantInstructions(Loop &L) {
-	int i = 0;
 	for (auto *BB : L.getBlocks()) {
+		// vivi alla fine del blocco: i valori definiti qui e usati in altri blocchi
+		SmallPtrSet<const Instruction *, 16> Live;
+		DenseMap<unsigned, unsigned> LiveCount;
 		for (auto &Inst : *BB) {
-			if (BB && isInstructionInvariant(Inst, L)) {
-				markInstruction(Inst, i);
-				i++;
+			auto ClassID = getRegisterClass(TTI, Inst.getType());
+			if (ClassID && !isHeaderPhi(&Inst) &&
+			    any_of(Inst.users(), [&](const User *U) { return cast<Instruction>(U)->getParent() != BB; })) {
+				Live.insert(&Inst);
+				++LiveCount[*ClassID];
+			}
+		}
+
+		for (auto &Inst : reverse(*BB)) {
+			if (Live.erase(&Inst)) --LiveCount[*getRegisterClass(TTI, Inst.getType())];
+			if (isa<PHINode>(Inst)) continue;
+
+			for (const Use &U : Inst.operands()) {
+				auto ClassID = getRegisterClass(TTI, U->getType());
+				if (!ClassID || isHeaderPhi(U)) continue;
+				auto *Op = dyn_cast<Instruction>(U);
+				if (isa<Argument>(U) || (Op && !L.contains(Op))) {
+					Usage.LiveIns.insert(U);
+				} else if (Op && Op->getParent() == BB && Live.insert(Op).second) {
+					++LiveCount[*ClassID];
+				}
 			}
+			for (auto &C : LiveCount) Usage.Peak[C.first] = std::max(Usage.Peak[C.first], C.second);
 		}
 	}
+	return Usage;
 }
 
+namespace {
+
+// Stima della pressione sui registri in un loop: la somma dei valori contati da
+// computeRegisterUsage, aggiornata mentre si scelgono le istruzioni da spostare.
+class RegisterPressure {
+	const Loop &L;
+	const TargetTransformInfo &TTI;
+	DenseMap<unsigned, unsigned> Pressure;
+	SmallPtrSet<const Value *, 32> LiveThrough;
 
+public:
+	RegisterPressure(const Loop &L, const TargetTransformInfo &TTI);
 
-// istruzione non ha usi al di fuori del loop
-bool MyLICM::isDOL(const Instruction &Inst,Loop &L) {
-	for (auto *User : Inst.users()) {
-		if (!L.contains(dyn_cast<Instruction>(User))) return false;
+	unsigned getLimit(unsigned ClassID) const {
+		return MaxRegisterPressure ? MaxRegisterPressure : TTI.getNumberOfRegisters(ClassID);
 	}
 
+	bool fits(unsigned ClassID, int Extra) const {
+		return Extra <= 0 || Pressure.lookup(ClassID) + Extra <= getLimit(ClassID);
+	}
+
+	void add(unsigned ClassID, int Extra) { Pressure[ClassID] += Extra; }
+
+	// V è vivo attraverso il loop e tutti i suoi usi nel loop soddisfano IsMoved:
+	// spostati quegli usi, V non è più vivo nel loop e libera il suo registro
+	template <typename PredT> bool isFreedBy(const Value *V, PredT IsMoved) const {
+		return LiveThrough.count(V) && all_of(V->users(), [&](const User *U) {
+			       auto *UI = dyn_cast<Instruction>(U);
+			       return !UI || !L.contains(UI) || IsMoved(UI);
+		       });
+	}
+
+	void release(const Value *V) { LiveThrough.erase(V); }
+};
+
+} // namespace
+
+RegisterPressure::RegisterPressure(const Loop &L, const TargetTransformInfo &TTI) : L(L), TTI(TTI) {
+	RegisterUsage Usage = computeRegisterUsage(L, TTI);
+	LiveThrough = std::move(Usage.LiveIns);
+	for (auto *V : LiveThrough) ++Pressure[*getRegisterClass(TTI, V->getType())];
+	for (auto &C : Usage.Through) Pressure[C.first] += C.second;
+	for (auto &C : Usage.Peak) Pressure[C.first] += C.second;
+}
+
+
+// Sceglie quali candidati spostare senza superare il limite di registri.
+// Spostare un valore che resta usato nel loop lo rende vivo per tutto il loop e
+// costa un registro della sua classe; un valore usato solo da altri candidati
+// spostati muore nel preheader e non costa nulla.
+// Le radici (candidati usati da istruzioni che restano nel loop) vengono ordinate
+// per beneficio, cioè il costo TTI delle istruzioni che non vengono più eseguite a
+// ogni iterazione, e spostate insieme agli operandi candidati finché c'è posto.
+// Le radici economiche finiscono in fondo: sono le prime a restare nel loop, dove
+// vengono ricalcolate a ogni iterazione invece di occupare un registro.
+static SmallPtrSet<Instruction *, 32> selectByRegisterPressure(ArrayRef<Instruction *> Candidates, Loop &L,
+                                                              LoopStandardAnalysisResults &LAR,
+                                                              OptimizationRemarkEmitter &ORE) {
+	SmallPtrSet<Instruction *, 32> IsCandidate(Candidates.begin(), Candidates.end());
+	SmallPtrSet<Instruction *, 32> Selected;
+	RegisterPressure Pressure(L, LAR.TTI);
+
+	auto isRoot = [&](Instruction *I) {
+		return any_of(I->users(), [&](User *U) { return !IsCandidate.count(cast<Instruction>(U)); });
+	};
+	// la radice e i suoi operandi candidati non ancora scelti
+	auto getClosure = [&](Instruction *Root, SmallVectorImpl<Instruction *> &Closure) {
+		SmallPtrSet<Instruction *, 16> Visited;
+		SmallVector<Instruction *, 16> Worklist{Root};
+		while (!Worklist.empty()) {
+			Instruction *I = Worklist.pop_back_val();
+			if (Selected.count(I) || !Visited.insert(I).second) continue;
+			Closure.push_back(I);
+			for (auto &U : I->operands()) {
+				auto *Op = dyn_cast<Instruction>(U);
+				if (Op && IsCandidate.count(Op)) Worklist.push_back(Op);
+			}
+		}
+	};
+	auto getCost = [&](Instruction *I) {
+		InstructionCost Cost = LAR.TTI.getInstructionCost(I, TargetTransformInfo::TCK_SizeAndLatency);
+		return Cost.isValid() ? *Cost.getValue() : 0;
+	};
+
+	SmallVector<std::pair<Instruction *, int64_t>, 16> Roots;
+	for (auto *I : Candidates) {
+		if (!isRoot(I)) continue;
+		SmallVector<Instruction *, 16> Closure;
+		getClosure(I, Closure);
+		int64_t Benefit = 0;
+		for (auto *C : Closure) Benefit += getCost(C);
+		Roots.push_back({I, Benefit});
+	}
+	// stable_sort: a parità di beneficio resta l'ordine RPO, il risultato è deterministico
+	llvm::stable_sort(Roots, [](const auto &A, const auto &B) { return A.second > B.second; });
+
+	for (auto &R : Roots) {
+		SmallVector<Instruction *, 16> Closure;
+		getClosure(R.first, Closure);
+
+		// registri in più: i valori della chiusura ancora usati da qualcosa che resta nel loop,
+		// meno gli operandi vivi attraverso il loop che dopo lo spostamento non vi sono più usati
+		SmallPtrSet<Instruction *, 16> InClosure(Closure.begin(), Closure.end());
+		auto isMoved = [&](const Instruction *UI) {
+			return Selected.count(UI) || InClosure.count(UI);
+		};
+		DenseMap<unsigned, int> Extra;
+		SmallPtrSet<Value *, 8> Freed;
+		for (auto *I : Closure) {
+			auto ClassID = getRegisterClass(LAR.TTI, I->getType());
+			if (ClassID && any_of(I->users(), [&](User *U) { return !isMoved(cast<Instruction>(U)); })) ++Extra[*ClassID];
+
+			for (Value *Op : I->operands()) {
+				if (Pressure.isFreedBy(Op, isMoved) && Freed.insert(Op).second)
+					--Extra[*getRegisterClass(LAR.TTI, Op->getType())];
+			}
+		}
+
+		if (!all_of(Extra, [&](const auto &E) { return Pressure.fits(E.first, E.second); })) {
+			++NumNotHoistedPressure;
+			ORE.emit([&]() {
+				return OptimizationRemarkMissed(DEBUG_TYPE, "RegisterPressure", R.first)
+				       << "not hoisting " << ore::NV("Inst", R.first)
+				       << ": it would exceed the register limit of its class";
+			});
+			continue;
+		}
+
+		for (auto &E : Extra) Pressure.add(E.first, E.second);
+		for (auto *V : Freed) Pressure.release(V);
+		Selected.insert(Closure.begin(), Closure.end());
+	}
+
+	return Selected;
+}
+
+
+// Crea il preheader se il loop non lo ha, con un blocco che riceve gli archi
+// entranti nell'header da fuori dal loop. Restituisce true se il loop è cambiato.
+static bool insertPreheader(Loop &L, LoopStandardAnalysisResults &LAR) {
+	if (L.getLoopPreheader()) return false;
+
+	std::unique_ptr<MemorySSAUpdater> MSSAU;
+	if (LAR.MSSA) MSSAU = std::make_unique<MemorySSAUpdater>(LAR.MSSA);
+	// fallisce se nell'header entra un indirectbr: il loop viene saltato
+	if (!InsertPreheaderForLoop(&L, &LAR.DT, &LAR.LI, MSSAU.get(), true)) return false;
+	++NumPreheaders;
 	return true;
 }
 
+// Un loop for o while esce dall'header: il corpo non è eseguito prima di quella
+// uscita, e le istruzioni invarianti che non si possono eseguire speculativamente
+// (una divisione, una load da un puntatore non dereferenceable) restano nel loop.
+// Se il corpo domina il latch, la rotazione in forma do-while, con la condizione
+// duplicata nel preheader come guardia, lo rende eseguito a ogni iterazione e quelle
+// istruzioni si possono spostare nel nuovo preheader, dentro la guardia.
+// Dopo la rotazione le invarianti vanno ricalcolate.
+static bool rotateForHoisting(Loop &L, const LoopInvariants &Invariants, LoopStandardAnalysisResults &LAR) {
+	BasicBlock *Latch = L.getLoopLatch();
+	if (!Latch || !L.getLoopPreheader() || L.isRotatedForm()) return false;
+
+	SimpleLoopSafetyInfo SafetyInfo;
+	SafetyInfo.computeLoopSafetyInfo(&L);
+	bool isBlocked = any_of(L.blocks(), [&](BasicBlock *BB) {
+		return LAR.DT.dominates(BB, Latch) && any_of(*BB, [&](Instruction &I) {
+			       return Invariants.contains(I) && !I.use_empty() && !isSafeToSpeculativelyExecute(&I) &&
+			              !SafetyInfo.isGuaranteedToExecute(I, &LAR.DT, &L);
+		       });
+	});
+	if (!isBlocked) return false;
+
+	std::unique_ptr<MemorySSAUpdater> MSSAU;
+	if (LAR.MSSA) MSSAU = std::make_unique<MemorySSAUpdater>(LAR.MSSA);
+	const DataLayout &DL = L.getHeader()->getModule()->getDataLayout();
+	SimplifyQuery SQ(DL, &LAR.TLI, &LAR.DT, &LAR.AC);
+	if (!LoopRotation(&L, &LAR.LI, &LAR.TTI, &LAR.AC, &LAR.DT, &LAR.SE, MSSAU.get(), SQ, false,
+	                  RotationMaxHeaderSize, false))
+		return false;
 
-// Sposta le istruzioni candidate se sono hoistable.
-// Se un'istruzione è candidata e senza usi viene rimossa, altrimenti
-// viene cancellato il metadato e spostata nel preheader se domina le uscite o è DOL.
+	++NumRotated;
+	return true;
+}
 
 
-bool MyLICM::moveHoistableInstructions(Loop &L,LoopStandardAnalysisResults &LAR) {
+// Sposta le istruzioni invarianti se sono hoistable.
+// Se un'istruzione è invariante e senza usi viene rimossa, altrimenti è candidata
+// se è eseguita a ogni iterazione prima di ogni uscita dal loop (con più uscite,
+// per esempio un break, deve precedere tutte) oppure se può essere eseguita
+// speculativamente: in quel caso eseguirla anche quando il loop non l'avrebbe
+// eseguita non ha effetti visibili. Tra le candidate il modello di costo
+// sceglie quelle che non fanno superare il limite di registri, che vengono
+// spostate nel preheader del loop più esterno in cui restano invarianti.
+// I blocchi sono visitati in reverse post-order: un operando invariante viene
+// spostato prima dei suoi usi, e un'istruzione si sposta solo se nessun suo
+// operando rimane nel loop.
+static bool hoistInvariants(LoopInvariants &Invariants, Loop &L, LoopStandardAnalysisResults &LAR) {
 	bool hasChanged = false;
-	llvm::SmallVector<std::pair<BasicBlock *, BasicBlock*>> EE;
-	L.getExitEdges(EE);
 	auto *PH = L.getLoopPreheader();
+	// Il loop pass non riceve l'ORE dall'analysis manager, lo costruisco sulla funzione
+	OptimizationRemarkEmitter ORE(L.getHeader()->getParent());
 
 	if (!PH) {
-		llvm::outs()<<"Il loop non è in forma canonica.\n";
+		++NumNoPreheader;
+		ORE.emit([&]() {
+			return OptimizationRemarkMissed(DEBUG_TYPE, "NoPreheader", L.getStartLoc(), L.getHeader())
+			       << "loop not in canonical form: no preheader";
+		});
 		return false;
 	}
 
+	// Con loop-mssa MemorySSA va tenuta aggiornata quando si spostano o si cancellano load
+	std::unique_ptr<MemorySSAUpdater> MSSAU;
+	if (LAR.MSSA) MSSAU = std::make_unique<MemorySSAUpdater>(LAR.MSSA);
+
+	// Istruzioni eseguite prima di ogni uscita: tiene conto di tutte le uscite e
+	// delle istruzioni che possono lanciare eccezioni prima di quella considerata
+	SimpleLoopSafetyInfo SafetyInfo;
+	SafetyInfo.computeLoopSafetyInfo(&L);
+
+	SmallVector<Instruction *, 32> Candidates;
+	SmallPtrSet<Instruction *, 32> IsCandidate;
+	LoopBlocksRPO RPOT(&L);
+	RPOT.perform(&LAR.LI);
+	for (auto *BB : RPOT) {
+		for (auto iter = BB->begin(), end = BB->end(); iter != end;) {
+			Instruction &I = *iter++;
+			if (!Invariants.contains(I)) continue;
+
+			if (I.getNumUses() == 0) {
+				hasChanged = true;
+				++NumErased;
+				Invariants.erase(I);
+				if (MSSAU) MSSAU->removeMemoryAccess(&I);
+				I.eraseFromParent();
+				continue;
+			}
+
+			// per una chiamata nounwind e willreturn la speculazione non basta: una
+			// funzione che non è speculatable può avere comportamento indefinito su
+			// argomenti che il loop non le avrebbe mai passato
+			if (!isSafeToSpeculativelyExecute(&I) && !SafetyInfo.isGuaranteedToExecute(I, &LAR.DT, &L)) continue;
+
+			bool areUseesMoved = all_of(I.operands(), [&](const Use &U) {
+				auto *Usee = dyn_cast<Instruction>(U);
+				return !Usee || !L.contains(Usee) || IsCandidate.count(Usee);
+			});
+			if (areUseesMoved) {
+				Candidates.push_back(&I);
+				IsCandidate.insert(&I);
+			}
+		}
+	}
+
+	SmallPtrSet<Instruction *, 32> Selected = selectByRegisterPressure(Candidates, L, LAR, ORE);
+	DenseMap<Loop *, std::unique_ptr<SimpleLoopSafetyInfo>> OuterSafety;
+
+	// le candidate sono in RPO: gli operandi si spostano prima degli usi
+	for (auto *Candidate : Candidates) {
+		Instruction &I = *Candidate;
+		if (!Selected.count(&I)) continue;
+
+		// la destinazione va scelta prima di spostare: i controlli di dominanza
+		// sulle uscite dei loop esterni partono dalla posizione originale
+		Loop *Target = getOutermostHoistTarget(I, L, LAR, OuterSafety);
+		BasicBlock *Dest = Target->getLoopPreheader();
+		I.moveBefore(Dest->getTerminator());
+		hasChanged = true;
+
+		++NumHoisted;
+		if (Target != &L) ++NumHoistedOuter;
+		if (isa<LoadInst>(I)) ++NumHoistedLoads;
+		if (isa<CallBase>(I)) ++NumHoistedCalls;
+		if (MSSAU) {
+			// le chiamate readnone non hanno un accesso in MemorySSA
+			if (MemoryUseOrDef *MA = LAR.MSSA->getMemoryAccess(&I))
+				MSSAU->moveToPlace(MA, Dest, MemorySSA::BeforeTerminator);
+		}
+		ORE.emit([&]() {
+			return OptimizationRemark(DEBUG_TYPE, "Hoisted", &I)
+			       << "hoisting " << ore::NV("Inst", &I) << " to the preheader of the loop at depth "
+			       << ore::NV("Depth", Target->getLoopDepth());
+		});
+	}
+
+	return hasChanged;
 	
+}
+
+
+
+namespace {
+
+// Riscrive gli accessi a una locazione promossa.
+// Le load del loop vengono sostituite da SSAUpdater con il valore corrente,
+// le store vengono cancellate e al loro posto si mette una store in ogni uscita.
+// Le uscite sono dedicate: se il valore è definito nel loop passa da una PHI LCSSA.
+class LoopPromoter : public LoadAndStorePromoter {
+	Value *Ptr;
+	Type *Ty;
+	Align Alignment;
+	Loop &L;
+	ArrayRef<BasicBlock *> Exits;
+	MemorySSAUpdater *MSSAU;
+
+public:
+	LoopPromoter(Value *Ptr, Type *Ty, Align Alignment, ArrayRef<const Instruction *> Insts, SSAUpdater &SSA,
+	             Loop &L, ArrayRef<BasicBlock *> Exits, MemorySSAUpdater *MSSAU)
+	    : LoadAndStorePromoter(Insts, SSA), Ptr(Ptr), Ty(Ty), Alignment(Alignment), L(L), Exits(Exits),
+	      MSSAU(MSSAU) {}
+
+	void doExtraRewritesBeforeFinalDeletion() override {
+		for (auto *Exit : Exits) {
+			Value *V = SSA.GetValueInMiddleOfBlock(Exit);
+			auto *I = dyn_cast<Instruction>(V);
+			if (I && L.contains(I)) {
+				PHINode *PN = PHINode::Create(Ty, pred_size(Exit), I->getName() + ".lcssa", &Exit->front());
+				for (auto *Pred : predecessors(Exit)) PN->addIncoming(I, Pred);
+				V = PN;
+			}
+
+			auto *Store = new StoreInst(V, Ptr, false, Alignment, &*Exit->getFirstInsertionPt());
+			if (MSSAU) {
+				MemoryAccess *MA = MSSAU->createMemoryAccessInBB(Store, nullptr, Exit, MemorySSA::Beginning);
+				MSSAU->insertDef(cast<MemoryDef>(MA), true);
+			}
+		}
+	}
+
+	void instructionDeleted(Instruction *I) const override {
+		if (MSSAU) MSSAU->removeMemoryAccess(I);
+	}
+};
+
+} // namespace
+
+// Raccoglie load e store semplici (non volatili e non atomiche) del loop
+// che usano Ptr come indirizzo.
+// Fallisce se Ptr ha altri usi nel loop (GEP, chiamate, store del puntatore stesso)
+// o se gli accessi non hanno tutti lo stesso tipo.
+static bool collectPromotableAccesses(Value *Ptr, Loop &L, SmallVectorImpl<Instruction *> &Accesses, Type *&Ty,
+                                      Align &Alignment) {
+	Ty = nullptr;
+	for (auto *User : Ptr->users()) {
+		auto *Inst = dyn_cast<Instruction>(User);
+		if (!Inst || !L.contains(Inst)) continue;
+
+		Type *AccessTy;
+		Align AccessAlign;
+		if (auto *Load = dyn_cast<LoadInst>(Inst)) {
+			if (!Load->isSimple()) return false;
+			AccessTy = Load->getType();
+			AccessAlign = Load->getAlign();
+		} else if (auto *Store = dyn_cast<StoreInst>(Inst)) {
+			if (!Store->isSimple() || Store->getValueOperand() == Ptr) return false;
+			AccessTy = Store->getValueOperand()->getType();
+			AccessAlign = Store->getAlign();
+		} else {
+			return false;
+		}
+
+		if (Ty && Ty != AccessTy) return false;
+		Ty = AccessTy;
+		Alignment = Accesses.empty() ? AccessAlign : std::min(Alignment, AccessAlign);
+		Accesses.push_back(Inst);
+	}
+	return Ty != nullptr;
+}
+
+// Una locazione si può tenere in registro se nessun'altra istruzione del loop
+// la legge o la scrive (secondo AA) e se mettere una load nel preheader e una store
+// in ogni uscita non introduce accessi che il programma non avrebbe fatto:
+// - o una store alla locazione viene eseguita prima di ogni uscita dal loop,
+// - o la locazione è un'alloca che non sfugge alla funzione ed è dereferenziabile.
+// Se un'istruzione del loop può lanciare un'eccezione la store ritardata sarebbe
+// visibile al chiamante, quindi si accettano solo alloca locali.
+static bool isPromotionSafe(Value *Ptr, Type *Ty, Align Alignment, ArrayRef<Instruction *> Accesses, Loop &L,
+                            LoopStandardAnalysisResults &LAR) {
+	const DataLayout &DL = L.getHeader()->getModule()->getDataLayout();
+	MemoryLocation Loc(Ptr, LocationSize::precise(DL.getTypeStoreSize(Ty)));
+	SmallPtrSet<Instruction *, 8> IsAccess(Accesses.begin(), Accesses.end());
+
+	bool mayThrow = false;
+	for (auto *BB : L.getBlocks()) {
+		for (auto &Inst : *BB) {
+			mayThrow |= Inst.mayThrow();
+			if (IsAccess.count(&Inst) || !Inst.mayReadOrWriteMemory()) continue;
+			if (isModOrRefSet(LAR.AA.getModRefInfo(&Inst, Loc))) return false;
+		}
+	}
+
+	const Value *Object = getUnderlyingObject(Ptr);
+	if (isa<AllocaInst>(Object) && !PointerMayBeCaptured(Object, true, true))
+		return isDereferenceableAndAlignedPointer(Ptr, Ty, Alignment, DL, L.getLoopPreheader()->getTerminator(),
+		                                          &LAR.DT);
+	if (mayThrow) return false;
+
+	SmallVector<BasicBlock *, 4> Exiting;
+	L.getExitingBlocks(Exiting);
+	return any_of(Accesses, [&](Instruction *Inst) {
+		return isa<StoreInst>(Inst) &&
+		       all_of(Exiting, [&](BasicBlock *BB) { return LAR.DT.dominates(Inst->getParent(), BB); });
+	});
+}
+
+// Promuove in registro le locazioni con indirizzo invariante che il loop legge
+// e scrive a ogni iterazione, come gli accumulatori in memoria.
+// La locazione viene letta una volta nel preheader, nel loop vive in PHI create
+// da SSAUpdater e viene riscritta in ogni blocco di uscita.
+static bool promoteLoopCarriedLocations(Loop &L, LoopStandardAnalysisResults &LAR) {
+	auto *PH = L.getLoopPreheader();
+	if (!PH || !L.hasDedicatedExits()) return false;
+
+	SmallVector<BasicBlock *, 4> Exits;
+	L.getUniqueExitBlocks(Exits);
+	if (Exits.empty() || any_of(Exits, [](BasicBlock *BB) { return BB->isEHPad(); })) return false;
+
+	// candidati: indirizzi invarianti delle store del loop
+	SmallSetVector<Value *, 8> Candidates;
+	for (auto *BB : L.getBlocks()) {
+		for (auto &Inst : *BB) {
+			auto *Store = dyn_cast<StoreInst>(&Inst);
+			if (Store && L.isLoopInvariant(Store->getPointerOperand())) Candidates.insert(Store->getPointerOperand());
+		}
+	}
+
+	OptimizationRemarkEmitter ORE(L.getHeader()->getParent());
+	std::unique_ptr<MemorySSAUpdater> MSSAU;
+	if (LAR.MSSA) MSSAU = std::make_unique<MemorySSAUpdater>(LAR.MSSA);
+
+	bool hasChanged = false;
+	for (auto *Ptr : Candidates) {
+		SmallVector<Instruction *, 8> Accesses;
+		Type *Ty;
+		Align Alignment;
+		if (!collectPromotableAccesses(Ptr, L, Accesses, Ty, Alignment)) continue;
+		if (!isPromotionSafe(Ptr, Ty, Alignment, Accesses, L, LAR)) {
+			ORE.emit([&]() {
+				return OptimizationRemarkMissed(DEBUG_TYPE, "PromoteUnsafe", Accesses.front())
+				       << "cannot promote " << ore::NV("Ptr", Ptr) << ": the location may be accessed otherwise";
+			});
+			continue;
+		}
+
+		SmallVector<const Instruction *, 8> Insts(Accesses.begin(), Accesses.end());
+		SmallVector<PHINode *, 8> NewPHIs;
+		SSAUpdater SSA(&NewPHIs);
+		LoopPromoter Promoter(Ptr, Ty, Alignment, Insts, SSA, L, Exits, MSSAU.get());
+
+		auto *PreheaderLoad =
+		    new LoadInst(Ty, Ptr, Ptr->getName() + ".promoted", false, Alignment, PH->getTerminator());
+		if (MSSAU) {
+			MemoryAccess *MA = MSSAU->createMemoryAccessInBB(PreheaderLoad, nullptr, PH, MemorySSA::End);
+			MSSAU->insertUse(cast<MemoryUse>(MA), true);
+		}
+		SSA.AddAvailableValue(PH, PreheaderLoad);
+		Promoter.run(Accesses);
+
+		if (PreheaderLoad->use_empty()) {
+			if (MSSAU) MSSAU->removeMemoryAccess(PreheaderLoad);
+			PreheaderLoad->eraseFromParent();
+		}
+
+		hasChanged = true;
+		++NumPromoted;
+		ORE.emit([&]() {
+			return OptimizationRemark(DEBUG_TYPE, "Promoted", L.getStartLoc(), L.getHeader())
+			       << "promoting " << ore::NV("Ptr", Ptr) << " to a register";
+		});
+	}
+
+	// SSAUpdater può mettere le PHI nei loop interni e usarle fuori da essi
+	if (hasChanged) formLCSSARecursively(L, LAR.DT, &LAR.LI, &LAR.SE);
+
+	return hasChanged;
+}
+
+
+// Blocchi che diventano irraggiungibili se si toglie l'arco From -> To, e i loop
+// più esterni tra quelli che muoiono con loro (l'header domina tutto il loop: se è
+// morto l'header è morto l'intero loop).
+// Restituisce false se tra i blocchi morti c'è il latch di un loop che resta vivo:
+// cancellarlo cambierebbe la struttura del loop e il branch va lasciato com'è.
+static bool collectBlocksDeadWithoutEdge(BasicBlock *From, BasicBlock *To, LoopInfo &LI,
+                                         SmallVectorImpl<BasicBlock *> &Dead, SmallVectorImpl<Loop *> &DeadLoops) {
+	Function &F = *From->getParent();
+	SmallPtrSet<BasicBlock *, 32> Reachable;
+	SmallVector<BasicBlock *, 32> Worklist{&F.getEntryBlock()};
+	while (!Worklist.empty()) {
+		BasicBlock *BB = Worklist.pop_back_val();
+		if (!Reachable.insert(BB).second) continue;
+		for (auto *Succ : successors(BB)) {
+			if (BB != From || Succ != To) Worklist.push_back(Succ);
+		}
+	}
+
+	for (auto *BB : depth_first(To)) {
+		if (!Reachable.count(BB)) Dead.push_back(BB);
+	}
+
+	SmallPtrSet<BasicBlock *, 32> IsDead(Dead.begin(), Dead.end());
+	for (auto *BB : Dead) {
+		for (Loop *BL = LI.getLoopFor(BB); BL; BL = BL->getParentLoop()) {
+			if (BL->isLoopLatch(BB) && !IsDead.count(BL->getHeader())) return false;
+		}
+		Loop *BL = LI.getLoopFor(BB);
+		if (BL && BL->getHeader() == BB && (BL->isOutermost() || !IsDead.count(BL->getParentLoop()->getHeader())))
+			DeadLoops.push_back(BL);
+	}
+	return true;
+}
+
+// Dopo l'unswitching la condizione nel loop è una costante: i select diventano
+// l'operando scelto e i branch diventano incondizionati, cancellando i blocchi che
+// non sono più raggiungibili. Il DominatorTree viene aggiornato con gli archi tolti.
+// Un branch sulla condizione che sceglie tra le due versioni di un loop interno, già
+// fatto unswitching sulla stessa condizione, lascia morta una delle due: il loop viene
+// tolto dal nido e, se LU è dato, segnalato come cancellato al loop pass manager
+// (la copia appena clonata non è ancora nel loop pass manager).
+static void foldUnswitchedCondition(Loop &L, LoopStandardAnalysisResults &LAR, DomTreeUpdater &DTU,
+                                    MemorySSAUpdater *MSSAU, LPMUpdater *LU) {
+	SmallVector<BranchInst *, 4> Branches;
 	for (auto *BB : L.getBlocks()) {
-		
 		for (auto iter = BB->begin(), end = BB->end(); iter != end;) {
 			Instruction &I = *iter++;
-			if (isInstructionMarked(I)) {
+			auto *Select = dyn_cast<SelectInst>(&I);
+			if (Select && isa<ConstantInt>(Select->getCondition())) {
+				bool Taken = cast<ConstantInt>(Select->getCondition())->isOne();
+				Select->replaceAllUsesWith(Taken ? Select->getTrueValue() : Select->getFalseValue());
+				Select->eraseFromParent();
+			}
+		}
+		auto *Br = dyn_cast<BranchInst>(BB->getTerminator());
+		if (Br && Br->isConditional() && isa<ConstantInt>(Br->getCondition())) Branches.push_back(Br);
+	}
+
+	for (auto *Br : Branches) {
+		BasicBlock *BB = Br->getParent();
+		bool Taken = cast<ConstantInt>(Br->getCondition())->isOne();
+		BasicBlock *Live = Br->getSuccessor(Taken ? 0 : 1);
+		BasicBlock *Dead = Br->getSuccessor(Taken ? 1 : 0);
+		if (Live == Dead) continue;
 
-				removeMarking(I);
+		SmallVector<BasicBlock *, 8> DeadBlocks;
+		SmallVector<Loop *, 2> DeadLoops;
+		if (!collectBlocksDeadWithoutEdge(BB, Dead, LAR.LI, DeadBlocks, DeadLoops)) continue;
 
-				if (I.getNumUses() == 0) {
-					hasChanged = true;
-					I.eraseFromParent();
-					continue;
+		Dead->removePredecessor(BB);
+		BranchInst::Create(Live, BB);
+		Br->eraseFromParent();
+		DTU.applyUpdates({{DominatorTree::Delete, BB, Dead}});
+		if (MSSAU) {
+			MSSAU->removeEdge(BB, Dead);
+			MSSAU->removeBlocks(SmallSetVector<BasicBlock *, 8>(DeadBlocks.begin(), DeadBlocks.end()));
+		}
+
+		// il nome del loop viene dall'header: vanno segnalati prima di togliere i blocchi
+		for (auto *DeadLoop : DeadLoops) {
+			if (!LU) break;
+			for (auto *Sub : DeadLoop->getLoopsInPreorder()) LU->markLoopAsDeleted(*Sub, Sub->getName());
+		}
+		for (auto *DeadBB : DeadBlocks) LAR.LI.removeBlock(DeadBB);
+		for (auto *DeadLoop : DeadLoops) {
+			if (Loop *Parent = DeadLoop->getParentLoop())
+				Parent->removeChildLoop(DeadLoop);
+			else
+				LAR.LI.removeLoop(find(LAR.LI, DeadLoop));
+			LAR.LI.destroy(DeadLoop);
+			++NumDeletedLoops;
+		}
+
+		// gli operandi usati solo dai blocchi morti (per esempio spostati nel loop esterno
+		// dallo hoisting del loop interno cancellato) restano senza usi
+		SmallPtrSet<BasicBlock *, 8> IsDead(DeadBlocks.begin(), DeadBlocks.end());
+		SmallVector<WeakTrackingVH, 8> Operands;
+		for (auto *DeadBB : DeadBlocks) {
+			for (auto &I : *DeadBB) {
+				for (Value *Op : I.operands()) {
+					auto *OpI = dyn_cast<Instruction>(Op);
+					if (OpI && !IsDead.count(OpI->getParent())) Operands.push_back(OpI);
 				}
+			}
+		}
+		DeleteDeadBlocks(DeadBlocks, &DTU);
+		RecursivelyDeleteTriviallyDeadInstructionsPermissive(Operands, &LAR.TLI, MSSAU);
+	}
+}
 
-				for (auto &E : EE) {
+// Profondità di unswitching di un loop e delle sue copie
+static const char *const UnswitchDepthAttr = "mylicm.unswitch.depth";
 
-					if (LAR.DT.dominates(&I, E.second) || isDOL(I, L)) {
-							bool areUseesMoved = true;
+// Toglie dal loop la profondità di unswitching quando sul loop non si fa più
+// unswitching: non deve restare nell'IR prodotto dal pass.
+static void dropUnswitchDepth(Loop &L) {
+	MDNode *LoopID = L.getLoopID();
+	if (!LoopID || !findOptionMDForLoopID(LoopID, UnswitchDepthAttr)) return;
+	MDNode *NewLoopID = makePostTransformationMetadata(L.getHeader()->getContext(), LoopID, {UnswitchDepthAttr}, {});
+	// senza altri attributi resta solo il riferimento a se stesso: il loop torna senza metadati
+	L.setLoopID(NewLoopID->getNumOperands() > 1 ? NewLoopID : nullptr);
+}
 
-						for (const auto &U : I.operands()) {
+// Sceglie la condizione su cui fare unswitching: la prima, in RPO, condizione
+// invariante e non costante di un branch condizionale o di un select del loop.
+// L'invarianza è quella calcolata da LoopInvariants: una condizione che lo hoisting
+// ha lasciato nel loop (per la pressione sui registri, o perché non si può eseguire
+// speculativamente) è ancora candidata, e in Chain finiscono le istruzioni del loop
+// da cui dipende, operandi prima degli usi, da spostare nel preheader prima di clonare.
+// Lo spostamento è lecito se ognuna è eseguita a ogni iterazione prima di ogni uscita
+// o si può eseguire speculativamente, come per lo hoisting.
+static Value *findUnswitchCondition(Loop &L, const LoopInvariants &Invariants, LoopStandardAnalysisResults &LAR,
+                                    SmallVectorImpl<Instruction *> &Chain) {
+	SimpleLoopSafetyInfo SafetyInfo;
+	SafetyInfo.computeLoopSafetyInfo(&L);
 
-							if (auto *Usee = dyn_cast<Instruction>(U)) {
-								if (!(LAR.DT.dominates(Usee, E.second) || isDOL(*Usee, L)))  {
-									areUseesMoved = false;
-							}
-							}
-						}
-						if (areUseesMoved) {
-							hasChanged = true;
-							I.moveBefore(PH->getTerminator());
+	// visita in post-order degli operandi nel loop
+	auto collectChain = [&](Value *Cond) {
+		Chain.clear();
+		SmallPtrSet<Instruction *, 8> Visited;
+		SmallVector<std::pair<Instruction *, bool>, 8> Worklist;
+		if (auto *CondI = dyn_cast<Instruction>(Cond)) Worklist.push_back({CondI, false});
+		while (!Worklist.empty()) {
+			auto [I, isExpanded] = Worklist.pop_back_val();
+			if (isExpanded) {
+				Chain.push_back(I);
+				continue;
+			}
+			if (!L.contains(I) || !Visited.insert(I).second) continue;
+			if (!Invariants.contains(*I)) return false;
+			if (!isSafeToSpeculativelyExecute(I) && !SafetyInfo.isGuaranteedToExecute(*I, &LAR.DT, &L))
+				return false;
+			Worklist.push_back({I, true});
+			for (Value *Op : I->operands()) {
+				if (auto *OpI = dyn_cast<Instruction>(Op)) Worklist.push_back({OpI, false});
+			}
+		}
+		return true;
+	};
 
+	LoopBlocksRPO RPOT(&L);
+	RPOT.perform(&LAR.LI);
+	for (auto *BB : RPOT) {
+		for (auto &Inst : *BB) {
+			Value *Cond = nullptr;
+			if (auto *Br = dyn_cast<BranchInst>(&Inst)) {
+				if (Br->isConditional() && Br->getSuccessor(0) != Br->getSuccessor(1)) Cond = Br->getCondition();
+			} else if (auto *Select = dyn_cast<SelectInst>(&Inst)) {
+				if (!Select->getCondition()->getType()->isVectorTy()) Cond = Select->getCondition();
+			}
+			if (Cond && !isa<Constant>(Cond) && collectChain(Cond)) return Cond;
+		}
+	}
+	return nullptr;
+}
 
-					}
+// Unswitching di una condizione invariante.
+// Il loop viene clonato: nel preheader si decide una volta sola quale copia
+// eseguire, nell'originale la condizione vale true e nella copia false, e in
+// entrambe i branch e i select su di essa spariscono.
+// La dimensione del loop (costo TTI di code size) moltiplicata per le copie che
+// esisteranno dopo questo unswitching deve stare nel budget: la profondità di
+// unswitching è salvata nei metadati del loop, così una sequenza di condizioni
+// non fa crescere il codice oltre il budget. Il metadato serve solo mentre il
+// loop pass manager rivisita il loop e le sue copie: run lo toglie quando sul
+// loop non si fa più unswitching.
+// Con MemorySSA (loop-mssa) gli accessi alla memoria vengono clonati insieme al loop,
+// e gli archi nuovi verso le uscite e quelli tolti dal folding aggiornano le MemoryPhi.
+static bool unswitchInvariantCondition(Loop &L, const LoopInvariants &Invariants, LoopStandardAnalysisResults &LAR,
+                                       LPMUpdater &LU) {
+	auto *PH = L.getLoopPreheader();
+	if (!PH || !L.hasDedicatedExits() || !L.isSafeToClone()) return false;
+	if (any_of(L.blocks(), [](BasicBlock *BB) { return BB->isEHPad(); })) return false;
 
-				}
-				}
+	SmallVector<Instruction *, 8> Chain;
+	Value *Cond = findUnswitchCondition(L, Invariants, LAR, Chain);
+	if (!Cond) return false;
+
+	OptimizationRemarkEmitter ORE(L.getHeader()->getParent());
+	unsigned Depth = getIntLoopAttribute(&L, UnswitchDepthAttr, 0);
+	int64_t Size = 0;
+	for (auto *BB : L.blocks()) {
+		for (auto &Inst : *BB) {
+			InstructionCost Cost = LAR.TTI.getInstructionCost(&Inst, TargetTransformInfo::TCK_CodeSize);
+			Size += Cost.isValid() ? *Cost.getValue() : 1;
+		}
+	}
+	if (Depth >= 16 || (Size << (Depth + 1)) > UnswitchThreshold) {
+		ORE.emit([&]() {
+			return OptimizationRemarkMissed(DEBUG_TYPE, "UnswitchTooBig", L.getStartLoc(), L.getHeader())
+			       << "not unswitching on " << ore::NV("Cond", Cond) << ": the loop would exceed the size budget";
+		});
+		return false;
+	}
+
+	LAR.SE.forgetLoop(&L);
+	std::unique_ptr<MemorySSAUpdater> MSSAU;
+	if (LAR.MSSA) MSSAU = std::make_unique<MemorySSAUpdater>(LAR.MSSA);
+
+	// la condizione va calcolata nel preheader, che sceglie la copia
+	for (auto *I : Chain) {
+		I->moveBefore(PH->getTerminator());
+		if (MSSAU) {
+			if (MemoryUseOrDef *MA = LAR.MSSA->getMemoryAccess(I))
+				MSSAU->moveToPlace(MA, PH, MemorySSA::BeforeTerminator);
+		}
+	}
+
+	SmallVector<BasicBlock *, 4> Exits;
+	L.getUniqueExitBlocks(Exits);
+
+	// PH decide quale copia eseguire, NewPH diventa il preheader dell'originale
+	BasicBlock *NewPH = SplitBlock(PH, PH->getTerminator(), &LAR.DT, &LAR.LI, MSSAU.get());
+	ValueToValueMapTy VMap;
+	SmallVector<BasicBlock *, 16> NewBlocks;
+	Loop *NewLoop = cloneLoopWithPreheader(NewPH, PH, &L, VMap, ".us", &LAR.LI, &LAR.DT, NewBlocks);
+	remapInstructionsInBlocks(NewBlocks, VMap);
+	if (MSSAU) {
+		LoopBlocksRPO RPOT(&L);
+		RPOT.perform(&LAR.LI);
+		MSSAU->updateForClonedLoop(RPOT, Exits, VMap);
+	}
+
+	// le PHI LCSSA delle uscite ricevono i valori anche dalla copia
+	for (auto *Exit : Exits) {
+		for (auto &Phi : Exit->phis()) {
+			for (unsigned i = 0, e = Phi.getNumIncomingValues(); i != e; ++i) {
+				BasicBlock *Incoming = Phi.getIncomingBlock(i);
+				if (!L.contains(Incoming)) continue;
+				Value *V = Phi.getIncomingValue(i);
+				Phi.addIncoming(VMap.count(V) ? static_cast<Value *>(VMap[V]) : V, cast<BasicBlock>(VMap[Incoming]));
 			}
-		
 		}
 	}
 
-	return hasChanged;
-	
+	// un branch su undef o poison è comportamento indefinito: se la condizione
+	// potrebbe esserlo (e il loop non l'avrebbe mai valutata) si congela
+	Instruction *OldBr = PH->getTerminator();
+	Value *Frozen = Cond;
+	if (!isGuaranteedNotToBeUndefOrPoison(Cond, nullptr, OldBr, &LAR.DT))
+		Frozen = new FreezeInst(Cond, Cond->getName() + ".fr", OldBr);
+	BranchInst::Create(NewPH, cast<BasicBlock>(VMap[NewPH]), Frozen, OldBr);
+	OldBr->eraseFromParent();
+
+	LLVMContext &Ctx = PH->getContext();
+	Cond->replaceUsesWithIf(ConstantInt::getTrue(Ctx), [&](Use &U) {
+		auto *User = dyn_cast<Instruction>(U.getUser());
+		return User && L.contains(User);
+	});
+	Cond->replaceUsesWithIf(ConstantInt::getFalse(Ctx), [&](Use &U) {
+		auto *User = dyn_cast<Instruction>(U.getUser());
+		return User && NewLoop->contains(User);
+	});
+
+	// cloneLoopWithPreheader ha già messo la copia nel DominatorTree sotto PH: mancano
+	// il nuovo arco da PH al suo preheader e gli archi dalla copia verso le uscite,
+	// che ora hanno come dominatore immediato PH. Le stesse inserzioni danno a MemorySSA
+	// le MemoryPhi delle uscite per gli accessi della copia.
+	SmallVector<DominatorTree::UpdateType, 8> Updates;
+	Updates.push_back({DominatorTree::Insert, PH, cast<BasicBlock>(VMap[NewPH])});
+	for (auto *BB : L.blocks()) {
+		for (auto *Succ : successors(BB)) {
+			if (!L.contains(Succ)) Updates.push_back({DominatorTree::Insert, cast<BasicBlock>(VMap[BB]), Succ});
+		}
+	}
+	LAR.DT.applyUpdates(Updates);
+	if (MSSAU) MSSAU->applyInsertUpdates(Updates, LAR.DT);
+	formDedicatedExitBlocks(&L, &LAR.DT, &LAR.LI, MSSAU.get(), true);
+	formDedicatedExitBlocks(NewLoop, &LAR.DT, &LAR.LI, MSSAU.get(), true);
+	DomTreeUpdater DTU(LAR.DT, DomTreeUpdater::UpdateStrategy::Eager);
+	foldUnswitchedCondition(L, LAR, DTU, MSSAU.get(), &LU);
+	foldUnswitchedCondition(*NewLoop, LAR, DTU, MSSAU.get(), nullptr);
+
+	addStringMetadataToLoop(&L, UnswitchDepthAttr, Depth + 1);
+	addStringMetadataToLoop(NewLoop, UnswitchDepthAttr, Depth + 1);
+
+	++NumUnswitched;
+	ORE.emit([&]() {
+		return OptimizationRemark(DEBUG_TYPE, "Unswitched", L.getStartLoc(), L.getHeader())
+		       << "unswitching on " << ore::NV("Cond", Cond);
+	});
+
+	// la copia va visitata dal loop pass manager, l'originale può avere altre condizioni
+	LU.addSiblingLoops({NewLoop});
+	LU.revisitCurrentLoop();
+	return true;
 }
 
 
+PreservedAnalyses MyLICM::run(Loop &L, LoopAnalysisManager &, LoopStandardAnalysisResults &LAR, LPMUpdater &LU) {
+	TimeTraceScope TimeScope("MyLICM", L.getHeader()->getName());
+	bool hasChanged = insertPreheader(L, LAR);
+	LoopInvariants Invariants(L, LAR);
+	Invariants.compute();
+	if (EnableRotation && rotateForHoisting(L, Invariants, LAR)) {
+		hasChanged = true;
+		Invariants.compute();
+	}
+	hasChanged |= hoistInvariants(Invariants, L, LAR);
+	// la promozione va dopo lo hoisting: gli indirizzi calcolati nel loop sono ora nel preheader
+	if (EnablePromotion) hasChanged |= promoteLoopCarriedLocations(L, LAR);
+	// l'unswitching clona il loop: va fatto per ultimo, sulle condizioni già spostate.
+	// Lo hoisting e la promozione hanno cambiato il loop: le invarianti vanno ricalcolate
+	if (EnableUnswitch) {
+		if (hasChanged) Invariants.compute();
+		if (unswitchInvariantCondition(L, Invariants, LAR, LU))
+			hasChanged = true;
+		else
+			dropUnswitchDepth(L);
+	}
+	if (!hasChanged) return PreservedAnalyses::all();
+
+	// le istruzioni spostate possono essere diventate invarianti anche nei loop esterni:
+	// SCEV non invalida le disposizioni di un solo loop, le cancella tutte
+	LAR.SE.forgetLoopDispositions();
 
-PreservedAnalyses MyLICM::run(Loop &L, LoopAnalysisManager &LAM, LoopStandardAnalysisResults &LAR, LPMUpdater &LU) {
-	checkForInvariantInstructions(L);
-	return moveHoistableInstructions(L,LAR) ? PreservedAnalyses::none() : PreservedAnalyses::all();
+	// Il loop pass manager con MemorySSA pretende che venga preservata:
+	// hoisting e promozione la aggiornano con MemorySSAUpdater
+	auto PA = getLoopPassPreservedAnalyses();
+	if (LAR.MSSA) PA.preserve<MemorySSAAnalysis>();
+	return PA;
 }
@@ -0,0 +1,27 @@
+//===-- MyLICM.h ------------------------------------------------------===//
+//
+// Questo file va inserito in llvm/include/llvm/Transforms/Utils
+//
+// Il pass espone solo run: le analisi e le trasformazioni sono funzioni
+// locali di MyLICM.cpp
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TRANSFORMS_UTILS_MYLICM_H
+#define LLVM_TRANSFORMS_UTILS_MYLICM_H
+
+#include "llvm/Analysis/LoopAnalysisManager.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/Transforms/Scalar/LoopPassManager.h"
+
+namespace llvm {
+
+class MyLICM : public PassInfoMixin<MyLICM> {
+public:
+	PreservedAnalyses run(Loop &L, LoopAnalysisManager &LAM, LoopStandardAnalysisResults &LAR,
+	                      LPMUpdater &LU);
+};
+
+} // namespace llvm
+
+#endif // LLVM_TRANSFORMS_UTILS_MYLICM_H
@@ -1,3 +1,4 @@
+#include <math.h>
 #include <stdio.h>
 
 int mylicm(int n){
@@ -14,6 +15,160 @@ int mylicm(int n){
     return sum;
 }
 
+struct vettore {
+    int *base;
+    int scala;
+};
+
+// base e scala non vengono mai scritti nel loop: le load vanno nel preheader
+int sommascalata(const struct vettore *v, int n){
+    int sum=0;
+    int i=0;
+    do {
+        sum+=v->base[i]*v->scala;
+        i++;
+    } while (i<n);
+
+    return sum;
+}
+
+// *sum viene letto e scritto a ogni iterazione: resta in un registro
+// e viene riscritto in memoria in entrambe le uscite
+int accumula(int *restrict sum, const int *a, int n, int limite){
+    int i=0;
+    do {
+        *sum+=a[i];
+        if (*sum>limite) return 1;
+        i++;
+    } while (i<n);
+
+    return 0;
+}
+
+// base e scala sono invarianti in entrambi i loop: vanno nel preheader del loop esterno,
+// i*m solo nel loop interno
+int sommamatrice(const struct vettore *v, int n, int m){
+    int sum=0;
+    int i=0;
+    do {
+        int j=0;
+        do {
+            sum+=v->base[i*m+j]*v->scala;
+            j++;
+        } while (j<m);
+        i++;
+    } while (i<n);
+
+    return sum;
+}
+
+__attribute__((const)) int hashcostante(int k){
+    return (k*31)^(k>>3);
+}
+
+__attribute__((pure)) int leggichiave(const int *tabella, int k){
+    return tabella[k&7];
+}
+
+// sqrt diventa llvm.sqrt, che è speculabile: va nel preheader anche se il corpo
+// del for non domina l'uscita
+double scalaradice(const double *a, int n, double x){
+    double sum=0;
+    for (int i=0; i<n; i++){
+        sum+=a[i]*sqrt(x);
+    }
+
+    return sum;
+}
+
+// hashcostante (const) e leggichiave (pure, il loop non scrive memoria) sono eseguite
+// prima dell'uscita del do-while: si spostano anche se non sono speculabili
+int sommahash(const int *tabella, const int *a, int n, int k){
+    int sum=0;
+    int i=0;
+    do {
+        sum+=a[i]*hashcostante(k)+leggichiave(tabella,k);
+        i++;
+    } while (i<n);
+
+    return sum;
+}
+
+// modo è invariante: il loop viene clonato e il test si fa una volta sola nel
+// preheader, nella copia per modo!=0 resta solo la somma e nell'altra la sottrazione
+int sommamodo(const int *a, int n, int modo){
+    int sum=0;
+    for (int i=0; i<n; i++){
+        if (modo)
+            sum+=a[i];
+        else
+            sum-=a[i];
+    }
+
+    return sum;
+}
+
+// il for ha due uscite, la condizione e il break: x/d non è speculabile (d può essere 0)
+// e nel for non è eseguita prima dell'uscita dall'header. Ruotato il loop in forma
+// do-while è eseguita a ogni iterazione prima di entrambe le uscite, e si sposta
+// nel preheader dentro la guardia i<n
+int cercasoglia(const int *a, int n, int x, int d){
+    int i;
+    for (i=0; i<n; i++){
+        if (a[i]>x/d)
+            break;
+    }
+
+    return i;
+}
+
+// con un limite di registri basso (-mylicm-max-pressure) non c'è posto per tutte
+// le invarianti: si sposta prima x/y, la più costosa, poi x*y e infine x+y.
+// x e y restano usati nel loop, spostarle non libera registri
+int pesata(const int *a, int n, int x, int y){
+    int sum=0;
+    int i=0;
+    do {
+        sum+=a[i]*(x/y)+x*y+(x+y)+(a[i]^x^y);
+        i++;
+    } while (i<n);
+
+    return sum;
+}
+
+// flag è invariante in entrambi i loop. L'unswitching del loop interno lascia il test
+// nel loop esterno, dove resta invariante, e l'unswitching del loop esterno lo porta
+// fuori dal nido: in ogni copia del loop esterno la versione del loop interno per
+// l'altro valore di flag non è più raggiungibile e viene cancellata
+int sommanido(const int *a, int n, int m, int flag){
+    int sum=0;
+    for (int i=0; i<n; i++){
+        for (int j=0; j<m; j++){
+            if (flag)
+                sum+=a[i*m+j];
+            else
+                sum-=a[i*m+j];
+        }
+    }
+
+    return sum;
+}
+
+// con un limite di registri basso il test x+y>10 resta nel loop: è comunque
+// invariante, e l'unswitching lo sposta nel preheader insieme a x+y prima di
+// clonare il loop
+int sommaguardata(const int *a, int n, int x, int y){
+    int sum=0;
+    for (int i=0; i<n; i++){
+        if (x+y>10)
+            sum+=a[i]*(x*y)+(x-y);
+        else
+            sum-=a[i];
+    }
+
+    return sum;
+}
+
 int main(){
     int risultato=mylicm(5);
     printf("risultato=%d\n",risultato);
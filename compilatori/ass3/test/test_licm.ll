@@ -1,8 +1,25 @@
+; RUN: opt -passes='mem2reg,loop(MyLICM)' -pass-remarks-output=%t.yaml -disable-output %s
+; RUN: FileCheck --check-prefix=REMARK %s < %t.yaml
+; REMARK:      --- !Passed
+; REMARK-NEXT: Pass:            mylicm
+; REMARK-NEXT: Name:            Hoisted
+; REMARK-NEXT: Function:        mylicm
+; RUN: opt -passes='mem2reg,loop(MyLICM)' -mylicm-max-pressure=2 -pass-remarks-output=%t.pressure.yaml -disable-output %s
+; RUN: FileCheck --check-prefix=PRESSURE %s < %t.pressure.yaml
+; PRESSURE:      Function:        sommaguardata
+; PRESSURE-NEXT: Args:
+; PRESSURE-NEXT:   - String:          'not hoisting '
+; PRESSURE-NEXT:   - Inst:            icmp
+; PRESSURE:      Name:            Unswitched
+; PRESSURE-NEXT: Function:        sommaguardata
+
 ; ModuleID = 'test_licm.c'
 source_filename = "test_licm.c"
 target datalayout = "e-m:o-p270:32:32-p271:32:32-p272:64:64-i64:64-i128:128-f80:128-n8:16:32:64-S128"
 target triple = "x86_64-apple-macosx15.0.0"
 
+%struct.vettore = type { ptr, i32 }
+
 @.str = private unnamed_addr constant [14 x i8] c"risultato=%d\0A\00", align 1
 
 ; Function Attrs: noinline nounwind ssp uwtable
@@ -48,6 +65,631 @@ define i32 @mylicm(i32 noundef %0) #0 {
   ret i32 %23
 }
 
+; Function Attrs: noinline nounwind ssp uwtable
+define i32 @sommascalata(ptr noundef %0, i32 noundef %1) #0 {
+  %3 = alloca ptr, align 8
+  %4 = alloca i32, align 4
+  %5 = alloca i32, align 4
+  %6 = alloca i32, align 4
+  store ptr %0, ptr %3, align 8
+  store i32 %1, ptr %4, align 4
+  store i32 0, ptr %5, align 4
+  store i32 0, ptr %6, align 4
+  br label %7
+
+7:                                                ; preds = %23, %2
+  %8 = load ptr, ptr %3, align 8
+  %9 = getelementptr inbounds %struct.vettore, ptr %8, i32 0, i32 0
+  %10 = load ptr, ptr %9, align 8
+  %11 = load i32, ptr %6, align 4
+  %12 = sext i32 %11 to i64
+  %13 = getelementptr inbounds i32, ptr %10, i64 %12
+  %14 = load i32, ptr %13, align 4
+  %15 = load ptr, ptr %3, align 8
+  %16 = getelementptr inbounds %struct.vettore, ptr %15, i32 0, i32 1
+  %17 = load i32, ptr %16, align 8
+  %18 = mul nsw i32 %14, %17
+  %19 = load i32, ptr %5, align 4
+  %20 = add nsw i32 %19, %18
+  store i32 %20, ptr %5, align 4
+  %21 = load i32, ptr %6, align 4
+  %22 = add nsw i32 %21, 1
+  store i32 %22, ptr %6, align 4
+  br label %23
+
+23:                                               ; preds = %7
+  %24 = load i32, ptr %6, align 4
+  %25 = load i32, ptr %4, align 4
+  %26 = icmp slt i32 %24, %25
+  br i1 %26, label %7, label %27, !llvm.loop !8
+
+27:                                               ; preds = %23
+  %28 = load i32, ptr %5, align 4
+  ret i32 %28
+}
+
+; Function Attrs: noinline nounwind ssp uwtable
+define i32 @accumula(ptr noalias noundef %0, ptr noundef %1, i32 noundef %2, i32 noundef %3) #0 {
+  %5 = alloca i32, align 4
+  %6 = alloca ptr, align 8
+  %7 = alloca ptr, align 8
+  %8 = alloca i32, align 4
+  %9 = alloca i32, align 4
+  %10 = alloca i32, align 4
+  store ptr %0, ptr %6, align 8
+  store ptr %1, ptr %7, align 8
+  store i32 %2, ptr %8, align 4
+  store i32 %3, ptr %9, align 4
+  store i32 0, ptr %10, align 4
+  br label %11
+
+11:                                               ; preds = %28, %4
+  %12 = load ptr, ptr %7, align 8
+  %13 = load i32, ptr %10, align 4
+  %14 = sext i32 %13 to i64
+  %15 = getelementptr inbounds i32, ptr %12, i64 %14
+  %16 = load i32, ptr %15, align 4
+  %17 = load ptr, ptr %6, align 8
+  %18 = load i32, ptr %17, align 4
+  %19 = add nsw i32 %18, %16
+  store i32 %19, ptr %17, align 4
+  %20 = load ptr, ptr %6, align 8
+  %21 = load i32, ptr %20, align 4
+  %22 = load i32, ptr %9, align 4
+  %23 = icmp sgt i32 %21, %22
+  br i1 %23, label %24, label %25
+
+24:                                               ; preds = %11
+  store i32 1, ptr %5, align 4
+  br label %33
+
+25:                                               ; preds = %11
+  %26 = load i32, ptr %10, align 4
+  %27 = add nsw i32 %26, 1
+  store i32 %27, ptr %10, align 4
+  br label %28
+
+28:                                               ; preds = %25
+  %29 = load i32, ptr %10, align 4
+  %30 = load i32, ptr %8, align 4
+  %31 = icmp slt i32 %29, %30
+  br i1 %31, label %11, label %32, !llvm.loop !9
+
+32:                                               ; preds = %28
+  store i32 0, ptr %5, align 4
+  br label %33
+
+33:                                               ; preds = %32, %24
+  %34 = load i32, ptr %5, align 4
+  ret i32 %34
+}
+
+; Function Attrs: noinline nounwind ssp uwtable
+define i32 @sommamatrice(ptr noundef %0, i32 noundef %1, i32 noundef %2) #0 {
+  %4 = alloca ptr, align 8
+  %5 = alloca i32, align 4
+  %6 = alloca i32, align 4
+  %7 = alloca i32, align 4
+  %8 = alloca i32, align 4
+  %9 = alloca i32, align 4
+  store ptr %0, ptr %4, align 8
+  store i32 %1, ptr %5, align 4
+  store i32 %2, ptr %6, align 4
+  store i32 0, ptr %7, align 4
+  store i32 0, ptr %8, align 4
+  br label %10
+
+10:                                               ; preds = %38, %3
+  store i32 0, ptr %9, align 4
+  br label %11
+
+11:                                               ; preds = %31, %10
+  %12 = load ptr, ptr %4, align 8
+  %13 = getelementptr inbounds %struct.vettore, ptr %12, i32 0, i32 0
+  %14 = load ptr, ptr %13, align 8
+  %15 = load i32, ptr %8, align 4
+  %16 = load i32, ptr %6, align 4
+  %17 = mul nsw i32 %15, %16
+  %18 = load i32, ptr %9, align 4
+  %19 = add nsw i32 %17, %18
+  %20 = sext i32 %19 to i64
+  %21 = getelementptr inbounds i32, ptr %14, i64 %20
+  %22 = load i32, ptr %21, align 4
+  %23 = load ptr, ptr %4, align 8
+  %24 = getelementptr inbounds %struct.vettore, ptr %23, i32 0, i32 1
+  %25 = load i32, ptr %24, align 8
+  %26 = mul nsw i32 %22, %25
+  %27 = load i32, ptr %7, align 4
+  %28 = add nsw i32 %27, %26
+  store i32 %28, ptr %7, align 4
+  %29 = load i32, ptr %9, align 4
+  %30 = add nsw i32 %29, 1
+  store i32 %30, ptr %9, align 4
+  br label %31
+
+31:                                               ; preds = %11
+  %32 = load i32, ptr %9, align 4
+  %33 = load i32, ptr %6, align 4
+  %34 = icmp slt i32 %32, %33
+  br i1 %34, label %11, label %35, !llvm.loop !10
+
+35:                                               ; preds = %31
+  %36 = load i32, ptr %8, align 4
+  %37 = add nsw i32 %36, 1
+  store i32 %37, ptr %8, align 4
+  br label %38
+
+38:                                               ; preds = %35
+  %39 = load i32, ptr %8, align 4
+  %40 = load i32, ptr %5, align 4
+  %41 = icmp slt i32 %39, %40
+  br i1 %41, label %10, label %42, !llvm.loop !11
+
+42:                                               ; preds = %38
+  %43 = load i32, ptr %7, align 4
+  ret i32 %43
+}
+
+; Function Attrs: noinline nounwind ssp willreturn memory(none) uwtable
+define i32 @hashcostante(i32 noundef %0) #2 {
+  %2 = alloca i32, align 4
+  store i32 %0, ptr %2, align 4
+  %3 = load i32, ptr %2, align 4
+  %4 = mul nsw i32 %3, 31
+  %5 = load i32, ptr %2, align 4
+  %6 = ashr i32 %5, 3
+  %7 = xor i32 %4, %6
+  ret i32 %7
+}
+
+; Function Attrs: noinline nounwind ssp willreturn memory(read) uwtable
+define i32 @leggichiave(ptr noundef %0, i32 noundef %1) #3 {
+  %3 = alloca ptr, align 8
+  %4 = alloca i32, align 4
+  store ptr %0, ptr %3, align 8
+  store i32 %1, ptr %4, align 4
+  %5 = load ptr, ptr %3, align 8
+  %6 = load i32, ptr %4, align 4
+  %7 = and i32 %6, 7
+  %8 = sext i32 %7 to i64
+  %9 = getelementptr inbounds i32, ptr %5, i64 %8
+  %10 = load i32, ptr %9, align 4
+  ret i32 %10
+}
+
+; Function Attrs: noinline nounwind ssp uwtable
+define double @scalaradice(ptr noundef %0, i32 noundef %1, double noundef %2) #0 {
+  %4 = alloca ptr, align 8
+  %5 = alloca i32, align 4
+  %6 = alloca double, align 8
+  %7 = alloca double, align 8
+  %8 = alloca i32, align 4
+  store ptr %0, ptr %4, align 8
+  store i32 %1, ptr %5, align 4
+  store double %2, ptr %6, align 8
+  store double 0.000000e+00, ptr %7, align 8
+  store i32 0, ptr %8, align 4
+  br label %9
+
+9:                                                ; preds = %23, %3
+  %10 = load i32, ptr %8, align 4
+  %11 = load i32, ptr %5, align 4
+  %12 = icmp slt i32 %10, %11
+  br i1 %12, label %13, label %26
+
+13:                                               ; preds = %9
+  %14 = load ptr, ptr %4, align 8
+  %15 = load i32, ptr %8, align 4
+  %16 = sext i32 %15 to i64
+  %17 = getelementptr inbounds double, ptr %14, i64 %16
+  %18 = load double, ptr %17, align 8
+  %19 = load double, ptr %6, align 8
+  %20 = call double @llvm.sqrt.f64(double %19)
+  %21 = load double, ptr %7, align 8
+  %22 = call double @llvm.fmuladd.f64(double %18, double %20, double %21)
+  store double %22, ptr %7, align 8
+  br label %23
+
+23:                                               ; preds = %13
+  %24 = load i32, ptr %8, align 4
+  %25 = add nsw i32 %24, 1
+  store i32 %25, ptr %8, align 4
+  br label %9, !llvm.loop !12
+
+26:                                               ; preds = %9
+  %27 = load double, ptr %7, align 8
+  ret double %27
+}
+
+; Function Attrs: nocallback nofree nosync nounwind speculatable willreturn memory(none)
+declare double @llvm.sqrt.f64(double) #4
+
+; Function Attrs: nocallback nofree nosync nounwind speculatable willreturn memory(none)
+declare double @llvm.fmuladd.f64(double, double, double) #4
+
+; Function Attrs: noinline nounwind ssp uwtable
+define i32 @sommahash(ptr noundef %0, ptr noundef %1, i32 noundef %2, i32 noundef %3) #0 {
+  %5 = alloca ptr, align 8
+  %6 = alloca ptr, align 8
+  %7 = alloca i32, align 4
+  %8 = alloca i32, align 4
+  %9 = alloca i32, align 4
+  %10 = alloca i32, align 4
+  store ptr %0, ptr %5, align 8
+  store ptr %1, ptr %6, align 8
+  store i32 %2, ptr %7, align 4
+  store i32 %3, ptr %8, align 4
+  store i32 0, ptr %9, align 4
+  store i32 0, ptr %10, align 4
+  br label %11
+
+11:                                               ; preds = %28, %4
+  %12 = load ptr, ptr %6, align 8
+  %13 = load i32, ptr %10, align 4
+  %14 = sext i32 %13 to i64
+  %15 = getelementptr inbounds i32, ptr %12, i64 %14
+  %16 = load i32, ptr %15, align 4
+  %17 = load i32, ptr %8, align 4
+  %18 = call i32 @hashcostante(i32 noundef %17) #5
+  %19 = mul nsw i32 %16, %18
+  %20 = load ptr, ptr %5, align 8
+  %21 = load i32, ptr %8, align 4
+  %22 = call i32 @leggichiave(ptr noundef %20, i32 noundef %21) #6
+  %23 = add nsw i32 %19, %22
+  %24 = load i32, ptr %9, align 4
+  %25 = add nsw i32 %24, %23
+  store i32 %25, ptr %9, align 4
+  %26 = load i32, ptr %10, align 4
+  %27 = add nsw i32 %26, 1
+  store i32 %27, ptr %10, align 4
+  br label %28
+
+28:                                               ; preds = %11
+  %29 = load i32, ptr %10, align 4
+  %30 = load i32, ptr %7, align 4
+  %31 = icmp slt i32 %29, %30
+  br i1 %31, label %11, label %32, !llvm.loop !13
+
+32:                                               ; preds = %28
+  %33 = load i32, ptr %9, align 4
+  ret i32 %33
+}
+
+; Function Attrs: noinline nounwind ssp uwtable
+define i32 @sommamodo(ptr noundef %0, i32 noundef %1, i32 noundef %2) #0 {
+  %4 = alloca ptr, align 8
+  %5 = alloca i32, align 4
+  %6 = alloca i32, align 4
+  %7 = alloca i32, align 4
+  %8 = alloca i32, align 4
+  store ptr %0, ptr %4, align 8
+  store i32 %1, ptr %5, align 4
+  store i32 %2, ptr %6, align 4
+  store i32 0, ptr %7, align 4
+  store i32 0, ptr %8, align 4
+  br label %9
+
+9:                                                ; preds = %33, %3
+  %10 = load i32, ptr %8, align 4
+  %11 = load i32, ptr %5, align 4
+  %12 = icmp slt i32 %10, %11
+  br i1 %12, label %13, label %36
+
+13:                                               ; preds = %9
+  %14 = load i32, ptr %6, align 4
+  %15 = icmp ne i32 %14, 0
+  br i1 %15, label %16, label %24
+
+16:                                               ; preds = %13
+  %17 = load ptr, ptr %4, align 8
+  %18 = load i32, ptr %8, align 4
+  %19 = sext i32 %18 to i64
+  %20 = getelementptr inbounds i32, ptr %17, i64 %19
+  %21 = load i32, ptr %20, align 4
+  %22 = load i32, ptr %7, align 4
+  %23 = add nsw i32 %22, %21
+  store i32 %23, ptr %7, align 4
+  br label %32
+
+24:                                               ; preds = %13
+  %25 = load ptr, ptr %4, align 8
+  %26 = load i32, ptr %8, align 4
+  %27 = sext i32 %26 to i64
+  %28 = getelementptr inbounds i32, ptr %25, i64 %27
+  %29 = load i32, ptr %28, align 4
+  %30 = load i32, ptr %7, align 4
+  %31 = sub nsw i32 %30, %29
+  store i32 %31, ptr %7, align 4
+  br label %32
+
+32:                                               ; preds = %24, %16
+  br label %33
+
+33:                                               ; preds = %32
+  %34 = load i32, ptr %8, align 4
+  %35 = add nsw i32 %34, 1
+  store i32 %35, ptr %8, align 4
+  br label %9, !llvm.loop !14
+
+36:                                               ; preds = %9
+  %37 = load i32, ptr %7, align 4
+  ret i32 %37
+}
+
+; Function Attrs: noinline nounwind ssp uwtable
+define i32 @cercasoglia(ptr noundef %0, i32 noundef %1, i32 noundef %2, i32 noundef %3) #0 {
+  %5 = alloca ptr, align 8
+  %6 = alloca i32, align 4
+  %7 = alloca i32, align 4
+  %8 = alloca i32, align 4
+  %9 = alloca i32, align 4
+  store ptr %0, ptr %5, align 8
+  store i32 %1, ptr %6, align 4
+  store i32 %2, ptr %7, align 4
+  store i32 %3, ptr %8, align 4
+  store i32 0, ptr %9, align 4
+  br label %10
+
+10:                                               ; preds = %26, %4
+  %11 = load i32, ptr %9, align 4
+  %12 = load i32, ptr %6, align 4
+  %13 = icmp slt i32 %11, %12
+  br i1 %13, label %14, label %29
+
+14:                                               ; preds = %10
+  %15 = load ptr, ptr %5, align 8
+  %16 = load i32, ptr %9, align 4
+  %17 = sext i32 %16 to i64
+  %18 = getelementptr inbounds i32, ptr %15, i64 %17
+  %19 = load i32, ptr %18, align 4
+  %20 = load i32, ptr %7, align 4
+  %21 = load i32, ptr %8, align 4
+  %22 = sdiv i32 %20, %21
+  %23 = icmp sgt i32 %19, %22
+  br i1 %23, label %24, label %25
+
+24:                                               ; preds = %14
+  br label %29
+
+25:                                               ; preds = %14
+  br label %26
+
+26:                                               ; preds = %25
+  %27 = load i32, ptr %9, align 4
+  %28 = add nsw i32 %27, 1
+  store i32 %28, ptr %9, align 4
+  br label %10, !llvm.loop !15
+
+29:                                               ; preds = %24, %10
+  %30 = load i32, ptr %9, align 4
+  ret i32 %30
+}
+
+; Function Attrs: noinline nounwind ssp uwtable
+define i32 @pesata(ptr noundef %0, i32 noundef %1, i32 noundef %2, i32 noundef %3) #0 {
+  %5 = alloca ptr, align 8
+  %6 = alloca i32, align 4
+  %7 = alloca i32, align 4
+  %8 = alloca i32, align 4
+  %9 = alloca i32, align 4
+  %10 = alloca i32, align 4
+  store ptr %0, ptr %5, align 8
+  store i32 %1, ptr %6, align 4
+  store i32 %2, ptr %7, align 4
+  store i32 %3, ptr %8, align 4
+  store i32 0, ptr %9, align 4
+  store i32 0, ptr %10, align 4
+  br label %11
+
+11:                                               ; preds = %43, %4
+  %12 = load ptr, ptr %5, align 8
+  %13 = load i32, ptr %10, align 4
+  %14 = sext i32 %13 to i64
+  %15 = getelementptr inbounds i32, ptr %12, i64 %14
+  %16 = load i32, ptr %15, align 4
+  %17 = load i32, ptr %7, align 4
+  %18 = load i32, ptr %8, align 4
+  %19 = sdiv i32 %17, %18
+  %20 = mul nsw i32 %16, %19
+  %21 = load i32, ptr %7, align 4
+  %22 = load i32, ptr %8, align 4
+  %23 = mul nsw i32 %21, %22
+  %24 = add nsw i32 %20, %23
+  %25 = load i32, ptr %7, align 4
+  %26 = load i32, ptr %8, align 4
+  %27 = add nsw i32 %25, %26
+  %28 = add nsw i32 %24, %27
+  %29 = load ptr, ptr %5, align 8
+  %30 = load i32, ptr %10, align 4
+  %31 = sext i32 %30 to i64
+  %32 = getelementptr inbounds i32, ptr %29, i64 %31
+  %33 = load i32, ptr %32, align 4
+  %34 = load i32, ptr %7, align 4
+  %35 = xor i32 %33, %34
+  %36 = load i32, ptr %8, align 4
+  %37 = xor i32 %35, %36
+  %38 = add nsw i32 %28, %37
+  %39 = load i32, ptr %9, align 4
+  %40 = add nsw i32 %39, %38
+  store i32 %40, ptr %9, align 4
+  %41 = load i32, ptr %10, align 4
+  %42 = add nsw i32 %41, 1
+  store i32 %42, ptr %10, align 4
+  br label %43
+
+43:                                               ; preds = %11
+  %44 = load i32, ptr %10, align 4
+  %45 = load i32, ptr %6, align 4
+  %46 = icmp slt i32 %44, %45
+  br i1 %46, label %11, label %47, !llvm.loop !16
+
+47:                                               ; preds = %43
+  %48 = load i32, ptr %9, align 4
+  ret i32 %48
+}
+
+; Function Attrs: noinline nounwind ssp uwtable
+define i32 @sommanido(ptr noundef %0, i32 noundef %1, i32 noundef %2, i32 noundef %3) #0 {
+  %5 = alloca ptr, align 8
+  %6 = alloca i32, align 4
+  %7 = alloca i32, align 4
+  %8 = alloca i32, align 4
+  %9 = alloca i32, align 4
+  %10 = alloca i32, align 4
+  %11 = alloca i32, align 4
+  store ptr %0, ptr %5, align 8
+  store i32 %1, ptr %6, align 4
+  store i32 %2, ptr %7, align 4
+  store i32 %3, ptr %8, align 4
+  store i32 0, ptr %9, align 4
+  store i32 0, ptr %10, align 4
+  br label %12
+
+12:                                               ; preds = %53, %4
+  %13 = load i32, ptr %10, align 4
+  %14 = load i32, ptr %6, align 4
+  %15 = icmp slt i32 %13, %14
+  br i1 %15, label %16, label %56
+
+16:                                               ; preds = %12
+  store i32 0, ptr %11, align 4
+  br label %17
+
+17:                                               ; preds = %49, %16
+  %18 = load i32, ptr %11, align 4
+  %19 = load i32, ptr %7, align 4
+  %20 = icmp slt i32 %18, %19
+  br i1 %20, label %21, label %52
+
+21:                                               ; preds = %17
+  %22 = load i32, ptr %8, align 4
+  %23 = icmp ne i32 %22, 0
+  br i1 %23, label %24, label %36
+
+24:                                               ; preds = %21
+  %25 = load ptr, ptr %5, align 8
+  %26 = load i32, ptr %10, align 4
+  %27 = load i32, ptr %7, align 4
+  %28 = mul nsw i32 %26, %27
+  %29 = load i32, ptr %11, align 4
+  %30 = add nsw i32 %28, %29
+  %31 = sext i32 %30 to i64
+  %32 = getelementptr inbounds i32, ptr %25, i64 %31
+  %33 = load i32, ptr %32, align 4
+  %34 = load i32, ptr %9, align 4
+  %35 = add nsw i32 %34, %33
+  store i32 %35, ptr %9, align 4
+  br label %48
+
+36:                                               ; preds = %21
+  %37 = load ptr, ptr %5, align 8
+  %38 = load i32, ptr %10, align 4
+  %39 = load i32, ptr %7, align 4
+  %40 = mul nsw i32 %38, %39
+  %41 = load i32, ptr %11, align 4
+  %42 = add nsw i32 %40, %41
+  %43 = sext i32 %42 to i64
+  %44 = getelementptr inbounds i32, ptr %37, i64 %43
+  %45 = load i32, ptr %44, align 4
+  %46 = load i32, ptr %9, align 4
+  %47 = sub nsw i32 %46, %45
+  store i32 %47, ptr %9, align 4
+  br label %48
+
+48:                                               ; preds = %36, %24
+  br label %49
+
+49:                                               ; preds = %48
+  %50 = load i32, ptr %11, align 4
+  %51 = add nsw i32 %50, 1
+  store i32 %51, ptr %11, align 4
+  br label %17, !llvm.loop !17
+
+52:                                               ; preds = %17
+  br label %53
+
+53:                                               ; preds = %52
+  %54 = load i32, ptr %10, align 4
+  %55 = add nsw i32 %54, 1
+  store i32 %55, ptr %10, align 4
+  br label %12, !llvm.loop !18
+
+56:                                               ; preds = %12
+  %57 = load i32, ptr %9, align 4
+  ret i32 %57
+}
+
+; Function Attrs: noinline nounwind ssp uwtable
+define i32 @sommaguardata(ptr noundef %0, i32 noundef %1, i32 noundef %2, i32 noundef %3) #0 {
+  %5 = alloca ptr, align 8
+  %6 = alloca i32, align 4
+  %7 = alloca i32, align 4
+  %8 = alloca i32, align 4
+  %9 = alloca i32, align 4
+  %10 = alloca i32, align 4
+  store ptr %0, ptr %5, align 8
+  store i32 %1, ptr %6, align 4
+  store i32 %2, ptr %7, align 4
+  store i32 %3, ptr %8, align 4
+  store i32 0, ptr %9, align 4
+  store i32 0, ptr %10, align 4
+  br label %11
+
+11:                                               ; preds = %43, %4
+  %12 = load i32, ptr %10, align 4
+  %13 = load i32, ptr %6, align 4
+  %14 = icmp slt i32 %12, %13
+  br i1 %14, label %15, label %46
+
+15:                                               ; preds = %11
+  %16 = load i32, ptr %7, align 4
+  %17 = load i32, ptr %8, align 4
+  %18 = add nsw i32 %16, %17
+  %19 = icmp sgt i32 %18, 10
+  br i1 %19, label %20, label %34
+
+20:                                               ; preds = %15
+  %21 = load ptr, ptr %5, align 8
+  %22 = load i32, ptr %10, align 4
+  %23 = sext i32 %22 to i64
+  %24 = getelementptr inbounds i32, ptr %21, i64 %23
+  %25 = load i32, ptr %24, align 4
+  %26 = load i32, ptr %7, align 4
+  %27 = load i32, ptr %8, align 4
+  %28 = mul nsw i32 %26, %27
+  %29 = mul nsw i32 %25, %28
+  %30 = sub nsw i32 %26, %27
+  %31 = add nsw i32 %29, %30
+  %32 = load i32, ptr %9, align 4
+  %33 = add nsw i32 %32, %31
+  store i32 %33, ptr %9, align 4
+  br label %42
+
+34:                                               ; preds = %15
+  %35 = load ptr, ptr %5, align 8
+  %36 = load i32, ptr %10, align 4
+  %37 = sext i32 %36 to i64
+  %38 = getelementptr inbounds i32, ptr %35, i64 %37
+  %39 = load i32, ptr %38, align 4
+  %40 = load i32, ptr %9, align 4
+  %41 = sub nsw i32 %40, %39
+  store i32 %41, ptr %9, align 4
+  br label %42
+
+42:                                               ; preds = %34, %20
+  br label %43
+
+43:                                               ; preds = %42
+  %44 = load i32, ptr %10, align 4
+  %45 = add nsw i32 %44, 1
+  store i32 %45, ptr %10, align 4
+  br label %11, !llvm.loop !19
+
+46:                                               ; preds = %11
+  %47 = load i32, ptr %9, align 4
+  ret i32 %47
+}
+
 ; Function Attrs: noinline nounwind ssp uwtable
 define i32 @main() #0 {
   %1 = alloca i32, align 4
@@ -64,6 +706,11 @@ declare i32 @printf(ptr noundef, ...) #1
 
 attributes #0 = { noinline nounwind ssp uwtable "darwin-stkchk-strong-link" "frame-pointer"="all" "min-legal-vector-width"="0" "no-trapping-math"="true" "probe-stack"="___chkstk_darwin" "stack-protector-buffer-size"="8" "target-cpu"="penryn" "target-features"="+cmov,+cx16,+cx8,+fxsr,+mmx,+sahf,+sse,+sse2,+sse3,+sse4.1,+ssse3,+x87" "tune-cpu"="generic" }
 attributes #1 = { "darwin-stkchk-strong-link" "frame-pointer"="all" "no-trapping-math"="true" "probe-stack"="___chkstk_darwin" "stack-protector-buffer-size"="8" "target-cpu"="penryn" "target-features"="+cmov,+cx16,+cx8,+fxsr,+mmx,+sahf,+sse,+sse2,+sse3,+sse4.1,+ssse3,+x87" "tune-cpu"="generic" }
+attributes #2 = { noinline nounwind ssp willreturn memory(none) uwtable "darwin-stkchk-strong-link" "frame-pointer"="all" "min-legal-vector-width"="0" "no-trapping-math"="true" "probe-stack"="___chkstk_darwin" "stack-protector-buffer-size"="8" "target-cpu"="penryn" "target-features"="+cmov,+cx16,+cx8,+fxsr,+mmx,+sahf,+sse,+sse2,+sse3,+sse4.1,+ssse3,+x87" "tune-cpu"="generic" }
+attributes #3 = { noinline nounwind ssp willreturn memory(read) uwtable "darwin-stkchk-strong-link" "frame-pointer"="all" "min-legal-vector-width"="0" "no-trapping-math"="true" "probe-stack"="___chkstk_darwin" "stack-protector-buffer-size"="8" "target-cpu"="penryn" "target-features"="+cmov,+cx16,+cx8,+fxsr,+mmx,+sahf,+sse,+sse2,+sse3,+sse4.1,+ssse3,+x87" "tune-cpu"="generic" }
+attributes #4 = { nocallback nofree nosync nounwind speculatable willreturn memory(none) }
+attributes #5 = { nounwind willreturn memory(none) }
+attributes #6 = { nounwind willreturn memory(read) }
 
 !llvm.module.flags = !{!0, !1, !2, !3, !4}
 !llvm.ident = !{!5}
@@ -76,3 +723,15 @@ attributes #1 = { "darwin-stkchk-strong-link" "frame-pointer"="all" "no-trapping
 !5 = !{!"Apple clang version 17.0.0 (clang-1700.6.3.2)"}
 !6 = distinct !{!6, !7}
 !7 = !{!"llvm.loop.mustprogress"}
+!8 = distinct !{!8, !7}
+!9 = distinct !{!9, !7}
+!10 = distinct !{!10, !7}
+!11 = distinct !{!11, !7}
+!12 = distinct !{!12, !7}
+!13 = distinct !{!13, !7}
+!14 = distinct !{!14, !7}
+!15 = distinct !{!15, !7}
+!16 = distinct !{!16, !7}
+!17 = distinct !{!17, !7}
+!18 = distinct !{!18, !7}
+!19 = distinct !{!19, !7}
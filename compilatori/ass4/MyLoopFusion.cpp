@@ -13,11 +13,758 @@
 
 #include "llvm/Transforms/Utils/MyLoopFusion.h"
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallSet.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/Analysis/DomTreeUpdater.h"
+#include "llvm/Analysis/MemoryBuiltins.h"
+#include "llvm/Analysis/OptimizationRemarkEmitter.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include "llvm/Transforms/Utils/LoopPeel.h"
+#include "llvm/Transforms/Utils/LoopUtils.h"
+#include "llvm/Transforms/Utils/SSAUpdater.h"
+#include "llvm/Transforms/Utils/ScalarEvolutionExpander.h"
+#include <optional>
 
 using namespace llvm;
 
+#define DEBUG_TYPE "myloopfusion"
+
+STATISTIC(NumFused, "Number of loops fused");
+STATISTIC(NumNotFused, "Number of candidate loop pairs not fused");
+STATISTIC(NumPeeled, "Number of iterations peeled to align trip counts");
+STATISTIC(NumUnprofitable, "Number of legal fusions rejected by the cost model");
+STATISTIC(NumContracted, "Number of temporary arrays contracted to scalars after fusion");
+STATISTIC(NumMovedAround, "Number of instructions moved out from between two loops");
+STATISTIC(NumReordered, "Number of loops moved to make a fusion partition adjacent");
+
+// Massima differenza tra i trip count che si allinea con il peeling
+static cl::opt<unsigned> MaxPeelCount(
+    "myloopfusion-max-peel", cl::init(8),
+    cl::desc("Maximum number of iterations peeled to align the trip counts of two loops"));
+
+// Con il modello di costo disabilitato si fonde ogni coppia di loop legale
+static cl::opt<bool> EnableCostModel(
+    "myloopfusion-cost-model", cl::init(true),
+    cl::desc("Skip fusions whose register spills outweigh the cache reuse they enable"));
+
+// Con la code motion disabilitata il codice tra due loop ne impedisce la fusione
+static cl::opt<bool> EnableCodeMotion(
+    "myloopfusion-code-motion", cl::init(true),
+    cl::desc("Move the code between two loops before the first or after the second to fuse "
+             "them"));
+
+static cl::opt<bool> EnableContraction(
+    "myloopfusion-contract", cl::init(true),
+    cl::desc("Replace temporary arrays written and read at the same index by a fused loop "
+             "with scalars"));
+
+
+// Scompone un backedge-taken count nella forma Offset + ext(X), quella dei loop
+// con IV a 64 bit e bound int, es. (-1 + (zext i32 (-1 + %n) to i64)).
+static const SCEVIntegralCastExpr *splitExtendedCount(const SCEV *TC, APInt &Offset) {
+  Offset = APInt(TC->getType()->getIntegerBitWidth(), 0);
+  if (auto *Add = dyn_cast<SCEVAddExpr>(TC)) {
+    auto *C = dyn_cast<SCEVConstant>(Add->getOperand(0));
+    if (Add->getNumOperands() != 2 || !C)
+      return nullptr;
+    Offset = C->getAPInt();
+    TC = Add->getOperand(1);
+  }
+  if (!isa<SCEVZeroExtendExpr>(TC) && !isa<SCEVSignExtendExpr>(TC))
+    return nullptr;
+  return cast<SCEVIntegralCastExpr>(TC);
+}
+
+// Con bound diversi (i < n e i < n-1) i due conteggi estendono espressioni
+// diverse e la loro differenza non si semplifica: si calcola prima
+// dell'estensione. L'estensione la conserva se entrambi i valori estesi sono
+// non negativi, cosa che devono garantire le guardie all'ingresso dei loop.
+static std::optional<APInt> getExtendedCountDifference(Loop *Lprev, const SCEV *PrevTC,
+                                                       Loop *Lnext, const SCEV *NextTC,
+                                                       ScalarEvolution &SE) {
+  APInt PrevOffset, NextOffset;
+  const SCEVIntegralCastExpr *PrevExt = splitExtendedCount(PrevTC, PrevOffset);
+  const SCEVIntegralCastExpr *NextExt = splitExtendedCount(NextTC, NextOffset);
+  if (!PrevExt || !NextExt || PrevExt->getSCEVType() != NextExt->getSCEVType())
+    return std::nullopt;
+
+  const SCEV *PrevBound = PrevExt->getOperand();
+  const SCEV *NextBound = NextExt->getOperand();
+  if (PrevBound->getType() != NextBound->getType())
+    return std::nullopt;
+  auto *BoundDiff = dyn_cast<SCEVConstant>(SE.getMinusSCEV(PrevBound, NextBound));
+  const SCEV *Zero = SE.getZero(PrevBound->getType());
+  if (!BoundDiff ||
+      !SE.isLoopEntryGuardedByCond(Lprev, ICmpInst::ICMP_SGE, PrevBound, Zero) ||
+      !SE.isLoopEntryGuardedByCond(Lnext, ICmpInst::ICMP_SGE, NextBound, Zero))
+    return std::nullopt;
+
+  return PrevOffset - NextOffset + BoundDiff->getAPInt().sext(PrevOffset.getBitWidth());
+}
+
+// Differenza costante tra i backedge-taken count dei due loop (Lprev - Lnext).
+static std::optional<int64_t> getTripCountDifference(Loop *Lprev, Loop *Lnext,
+                                                     ScalarEvolution &SE) {
+  const SCEV *PrevTC = SE.getBackedgeTakenCount(Lprev);
+  const SCEV *NextTC = SE.getBackedgeTakenCount(Lnext);
+  if (isa<SCEVCouldNotCompute>(PrevTC) || isa<SCEVCouldNotCompute>(NextTC))
+    return std::nullopt;
+  if (SE.isKnownPredicate(CmpInst::ICMP_EQ, PrevTC, NextTC))
+    return 0;
+
+  // IV di larghezza diversa: si confrontano i conteggi estesi al tipo più largo
+  Type *Ty = SE.getWiderType(PrevTC->getType(), NextTC->getType());
+  PrevTC = SE.getNoopOrZeroExtend(PrevTC, Ty);
+  NextTC = SE.getNoopOrZeroExtend(NextTC, Ty);
+  std::optional<APInt> Diff;
+  if (auto *C = dyn_cast<SCEVConstant>(SE.getMinusSCEV(PrevTC, NextTC)))
+    Diff = C->getAPInt();
+  else
+    Diff = getExtendedCountDifference(Lprev, PrevTC, Lnext, NextTC, SE);
+  if (!Diff || Diff->getSignificantBits() > 64)
+    return std::nullopt;
+  return Diff->getSExtValue();
+}
+
+// Peeling in coda: serve un loop a blocco singolo con un'unica uscita dedicata,
+// l'IV come unico PHI, bounds riconosciuti da LoopBounds con passo costante e
+// valore iniziale dell'IV disponibile prima del loop Lprev con cui verrà fuso
+// (il resto riparte da lì quando il loop fuso non viene eseguito).
+static bool canPeelLast(Loop *Lprev, Loop *L, DominatorTree &DT, ScalarEvolution &SE) {
+  BasicBlock *Header = L->getHeader();
+  BasicBlock *PH = L->getLoopPreheader();
+  BasicBlock *Exit = L->getExitBlock();
+  if (Header != L->getLoopLatch() || !PH || !Exit ||
+      Exit->getSinglePredecessor() != Header || !L->isSafeToClone())
+    return false;
+
+  PHINode *IV = L->getInductionVariable(SE);
+  auto Bounds = L->getBounds(SE);
+  if (!IV || !Bounds || !isa<ConstantInt>(Bounds->getStepValue()) ||
+      std::next(Header->phis().begin()) != Header->phis().end())
+    return false;
+
+  auto *Start = dyn_cast<Instruction>(&Bounds->getInitialIVValue());
+  return !Start || DT.dominates(Start, Lprev->getHeader());
+}
+
+// Toglie le ultime Count iterazioni di L: il loop termina Count passi prima e
+// un resto (copia del loop) riparte dal valore con cui esce l'IV ed esegue le
+// iterazioni mancanti prima dell'uscita originale.
+// La PHI all'inizio del preheader del resto è il punto di ripartenza: merge le
+// aggiunge il valore iniziale dell'IV sui percorsi in cui L non viene eseguito.
+static void peelLastIterations(Loop *L, unsigned Count, LoopInfo &LI,
+                               DominatorTree &DT, ScalarEvolution &SE) {
+  BasicBlock *Header = L->getHeader();
+  BasicBlock *PH = L->getLoopPreheader();
+  BasicBlock *Exit = L->getExitBlock();
+  PHINode *IV = L->getInductionVariable(SE);
+  auto Bounds = L->getBounds(SE);
+  Value *Final = &Bounds->getFinalIVValue();
+  auto *Step = cast<ConstantInt>(Bounds->getStepValue());
+  ICmpInst *Cmp = L->getLatchCmpInst();
+  SE.forgetLoop(L);
+
+  // Il resto va tra il loop e la sua uscita, la copia del preheader è il suo preheader
+  ValueToValueMapTy VMap;
+  SmallVector<BasicBlock *, 4> Blocks;
+  Loop *Rem = cloneLoopWithPreheader(Exit, Header, L, VMap, ".peel", &LI, &DT, Blocks);
+  remapInstructionsInBlocks(Blocks, VMap);
+  auto *RemPH = cast<BasicBlock>(VMap[PH]);
+  auto *RemHeader = cast<BasicBlock>(VMap[Header]);
+  Header->getTerminator()->replaceSuccessorWith(Exit, RemPH);
+  DomTreeUpdater DTU(DT, DomTreeUpdater::UpdateStrategy::Eager);
+  DTU.applyUpdates({{DominatorTree::Insert, Header, RemPH},
+                    {DominatorTree::Delete, Header, Exit}});
+
+  auto *RemStart = PHINode::Create(IV->getType(), 1, IV->getName() + ".peel.start",
+                                   &RemPH->front());
+  RemStart->addIncoming(IV->getIncomingValueForBlock(Header), Header);
+  cast<PHINode>(VMap[IV])->setIncomingValueForBlock(RemPH, RemStart);
+
+  // Dopo il loop si usano i valori dell'ultima iterazione, calcolati dal resto
+  for (PHINode &Phi : Exit->phis()) {
+    int Idx = Phi.getBasicBlockIndex(Header);
+    if (Value *Cloned = VMap.lookup(Phi.getIncomingValue(Idx)))
+      Phi.setIncomingValue(Idx, Cloned);
+    Phi.setIncomingBlock(Idx, RemHeader);
+  }
+  for (Instruction &I : *Header) {
+    I.replaceUsesWithIf(VMap.lookup(&I), [&](Use &U) {
+      auto *User = cast<Instruction>(U.getUser());
+      return !L->contains(User) && !Rem->contains(User) && User->getParent() != RemPH;
+    });
+  }
+
+  // Il loop accorciato termina Count passi prima del valore finale
+  IRBuilder<> Builder(PH->getTerminator());
+  APInt Delta = Step->getValue() * Count;
+  Value *NewFinal = Builder.CreateSub(Final, ConstantInt::get(Final->getType(), Delta));
+  Cmp->replaceUsesOfWith(Final, NewFinal);
+}
+
+// Le iterazioni in più vengono tolte in testa al primo loop o in coda al
+// secondo: quelle tolte restano prima o dopo il loop fuso, nello stesso ordine
+// rispetto all'altro loop in cui erano prima della fusione.
+// Il peeling è fatto solo per i loop a blocco singolo, che merge fonde spostando
+// il corpo del secondo nell'header del primo.
+static bool canAlignTripCounts(Loop *Lprev, Loop *Lnext, int64_t Diff,
+                               DominatorTree &DT, ScalarEvolution &SE) {
+  if (Diff == 0)
+    return true;
+  if (std::abs(Diff) > MaxPeelCount)
+    return false;
+  if (Lprev->getHeader() != Lprev->getLoopLatch() ||
+      Lnext->getHeader() != Lnext->getLoopLatch())
+    return false;
+
+  return Diff > 0 ? canPeel(Lprev) : canPeelLast(Lprev, Lnext, DT, SE);
+}
+
+// Dopo il peeling in testa le iterazioni tolte escono nella vecchia uscita del
+// loop, e simplifyLoop crea una nuova uscita dedicata che prosegue lì. Se la
+// vecchia uscita è vuota i suoi predecessori saltano direttamente al suo
+// successore: l'uscita del loop arriva di nuovo al guard o al preheader del
+// loop successivo.
+static void bypassEmptyExit(Loop *L, LoopInfo &LI, DominatorTree &DT) {
+  BasicBlock *Exit = L->getExitBlock();
+  BasicBlock *OldExit = Exit ? Exit->getSingleSuccessor() : nullptr;
+  BasicBlock *Succ = OldExit ? OldExit->getSingleSuccessor() : nullptr;
+  if (!Succ || OldExit == Exit || Succ == OldExit ||
+      &OldExit->front() != OldExit->getTerminator() || !Succ->phis().empty() ||
+      LI.isLoopHeader(OldExit) || OldExit->hasAddressTaken())
+    return;
+  SmallVector<BasicBlock *, 4> Preds(predecessors(OldExit));
+  if (any_of(Preds, [&](BasicBlock *Pred) { return is_contained(successors(Pred), Succ); }))
+    return;
+
+  DomTreeUpdater DTU(DT, DomTreeUpdater::UpdateStrategy::Eager);
+  SmallVector<DominatorTree::UpdateType, 8> Updates;
+  for (BasicBlock *Pred : Preds) {
+    Pred->getTerminator()->replaceSuccessorWith(OldExit, Succ);
+    Updates.push_back({DominatorTree::Insert, Pred, Succ});
+    Updates.push_back({DominatorTree::Delete, Pred, OldExit});
+  }
+  DTU.applyUpdates(Updates);
+  LI.removeBlock(OldExit);
+  DeleteDeadBlock(OldExit, &DTU);
+}
+
+// Restituisce true se il primo loop è stato accorciato in testa: peelLoop ne
+// ricrea preheader e uscita.
+static bool alignTripCounts(Loop *Lprev, Loop *Lnext, Function &F,
+                            FunctionAnalysisManager &FAM) {
+  ScalarEvolution &SE = FAM.getResult<ScalarEvolutionAnalysis>(F);
+  LoopInfo &LI = FAM.getResult<LoopAnalysis>(F);
+  DominatorTree &DT = FAM.getResult<DominatorTreeAnalysis>(F);
+  AssumptionCache &AC = FAM.getResult<AssumptionAnalysis>(F);
+
+  int64_t Diff = *getTripCountDifference(Lprev, Lnext, SE);
+  if (Diff == 0)
+    return false;
+
+  if (Diff > 0) {
+    ValueToValueMapTy VMap;
+    peelLoop(Lprev, Diff, &LI, &SE, DT, &AC, false, VMap);
+    bypassEmptyExit(Lprev, LI, DT);
+  } else
+    peelLastIterations(Lnext, -Diff, LI, DT, SE);
+  NumPeeled += std::abs(Diff);
+  return Diff > 0;
+}
+
+// L'IV del secondo loop si può riscrivere in funzione del primo se è una
+// ricorrenza affine con valore iniziale e passo disponibili prima del primo loop.
+static bool canRewriteInductionVariable(Loop *Lprev, PHINode *NextIV,
+                                        ScalarEvolution &SE) {
+  auto *Rec = dyn_cast<SCEVAddRecExpr>(SE.getSCEV(NextIV));
+  return Rec && Rec->isAffine() &&
+         SE.isAvailableAtLoopEntry(Rec->getStart(), Lprev) &&
+         SE.isAvailableAtLoopEntry(Rec->getStepRecurrence(SE), Lprev);
+}
+
+// All'iterazione k del loop fuso l'IV del secondo loop vale Start + k * Step:
+// è la stessa ricorrenza, costruita sul primo loop. Se coincide con l'IV del
+// primo (stesso valore iniziale e stesso passo) si usa quella, altrimenti viene
+// generata nell'header del primo loop.
+static void replaceInductionVariable(Loop *Lprev, PHINode *PrevIV, PHINode *NextIV,
+                                     ScalarEvolution &SE) {
+  auto *NextRec = cast<SCEVAddRecExpr>(SE.getSCEV(NextIV));
+  const SCEV *Rec = SE.getAddRecExpr(NextRec->getStart(), NextRec->getStepRecurrence(SE),
+                                     Lprev, SCEV::FlagAnyWrap);
+  Value *NewIV = PrevIV;
+  if (SE.getSCEV(PrevIV) != Rec) {
+    const DataLayout &DL = Lprev->getHeader()->getModule()->getDataLayout();
+    SCEVExpander Expander(SE, DL, "fused.iv");
+    NewIV = Expander.expandCodeFor(Rec, NextIV->getType(),
+                                   &*Lprev->getHeader()->getFirstInsertionPt());
+  }
+
+  NextIV->replaceAllUsesWith(NewIV);
+  NextIV->eraseFromParent();
+}
+
+// Load e store del loop; false se il loop contiene altre istruzioni che
+// accedono alla memoria (chiamate), di cui non si conoscono gli indirizzi.
+static bool collectMemoryAccesses(Loop *L, SmallVectorImpl<Instruction *> &Accesses) {
+  for (BasicBlock *BB : L->getBlocks()) {
+    for (Instruction &I : *BB) {
+      if (isa<LoadInst>(&I) || isa<StoreInst>(&I))
+        Accesses.push_back(&I);
+      else if (I.mayReadOrWriteMemory())
+        return false;
+    }
+  }
+  return true;
+}
+
+// Iterazioni tolte in testa al primo loop da alignTripCounts: l'iterazione i del
+// primo loop diventa l'iterazione i - PeelPrev del loop fuso. Il peeling in coda
+// del secondo non sposta le iterazioni che restano nel loop fuso.
+static int64_t getPrevPeelCount(Loop *Lprev, Loop *Lnext, ScalarEvolution &SE) {
+  return std::max<int64_t>(getTripCountDifference(Lprev, Lnext, SE).value_or(0), 0);
+}
+
+// Distanza, in iterazioni del loop fuso, tra l'accesso I del primo loop e
+// l'accesso J del secondo allo stesso indirizzo: con indirizzi A + i * S e
+// B + j * S si ha j - i = (A - B) / S, a cui si aggiungono le iterazioni tolte in
+// testa al primo loop. Nessun valore se gli indirizzi non sono ricorrenze affini dei
+// rispettivi loop con lo stesso passo costante e la distanza non è una costante.
+// Nella fusione di due nidi gli accessi dei loop interni devono avere gli stessi
+// passi e trip count, e restare entro S byte per iterazione del loop esterno:
+// due accessi allo stesso indirizzo cadono allora nella stessa "riga".
+static std::optional<int64_t> getFusedDistance(Instruction &I, Instruction &J, Loop *Lprev,
+                                               Loop *Lnext, int64_t PeelPrev,
+                                               ScalarEvolution &SE) {
+  const DataLayout &DL = I.getModule()->getDataLayout();
+  if (DL.getTypeStoreSize(getLoadStoreType(&I)) != DL.getTypeStoreSize(getLoadStoreType(&J)))
+    return std::nullopt;
+
+  const SCEV *PtrI = SE.getSCEV(getLoadStorePointerOperand(&I));
+  const SCEV *PtrJ = SE.getSCEV(getLoadStorePointerOperand(&J));
+  const SCEV *Span = SE.getZero(DL.getIndexType(PtrI->getType()));
+  auto *RecI = dyn_cast<SCEVAddRecExpr>(PtrI);
+  auto *RecJ = dyn_cast<SCEVAddRecExpr>(PtrJ);
+  while (RecI && RecJ && RecI->getLoop() != Lprev && RecJ->getLoop() != Lnext) {
+    const Loop *InnerI = RecI->getLoop();
+    const Loop *InnerJ = RecJ->getLoop();
+    if (!Lprev->contains(InnerI) || !Lnext->contains(InnerJ) ||
+        InnerI->getLoopDepth() != InnerJ->getLoopDepth() || !RecI->isAffine() ||
+        !RecJ->isAffine())
+      return std::nullopt;
+
+    auto *InnerStep = dyn_cast<SCEVConstant>(RecI->getStepRecurrence(SE));
+    const SCEV *BTC = SE.getBackedgeTakenCount(InnerI);
+    if (!InnerStep || InnerStep != RecJ->getStepRecurrence(SE) ||
+        isa<SCEVCouldNotCompute>(BTC) || BTC != SE.getBackedgeTakenCount(InnerJ))
+      return std::nullopt;
+    Span = SE.getAddExpr(Span, SE.getMulExpr(SE.getNoopOrZeroExtend(BTC, Span->getType()),
+                                             SE.getConstant(InnerStep->getAPInt().abs())));
+    RecI = dyn_cast<SCEVAddRecExpr>(RecI->getStart());
+    RecJ = dyn_cast<SCEVAddRecExpr>(RecJ->getStart());
+  }
+  if (!RecI || !RecJ || RecI->getLoop() != Lprev || RecJ->getLoop() != Lnext ||
+      !RecI->isAffine() || !RecJ->isAffine())
+    return std::nullopt;
+
+  auto *Step = dyn_cast<SCEVConstant>(RecI->getStepRecurrence(SE));
+  auto *Diff = dyn_cast<SCEVConstant>(SE.getMinusSCEV(RecI->getStart(), RecJ->getStart()));
+  if (!Step || Step->isZero() || Step != RecJ->getStepRecurrence(SE) || !Diff)
+    return std::nullopt;
+  if (!Span->isZero() &&
+      !SE.isKnownPredicate(ICmpInst::ICMP_ULT, Span,
+                           SE.getConstant(Step->getAPInt().abs())))
+    return std::nullopt;
+
+  // Con una differenza non multipla del passo gli accessi non coincidono mai, ma
+  // possono sovrapporsi in parte: si resta conservativi.
+  APInt Quot, Rem;
+  APInt::sdivrem(Diff->getAPInt(), Step->getAPInt().sextOrTrunc(Diff->getAPInt().getBitWidth()),
+                 Quot, Rem);
+  if (!Rem.isZero() || Quot.getSignificantBits() > 32)
+    return std::nullopt;
+  return Quot.getSExtValue() + PeelPrev;
+}
+
+// Una dipendenza che su un loop contenente entrambi non ha direzione = è
+// portata da quel loop e la fusione non la cambia.
+static bool isCarriedByCommonLoop(const Dependence &Dep) {
+  for (unsigned Level = 1; Level <= Dep.getLevels(); ++Level)
+    if (!(Dep.getDirection(Level) & Dependence::DVEntry::EQ))
+      return true;
+  return false;
+}
+
+// Classe di registri TTI di un tipo, nessuna per i tipi che non occupano
+// registri.
+static std::optional<unsigned> getRegisterClass(const TargetTransformInfo &TTI,
+                                                Type *Ty) {
+  if (!Ty->isIntOrIntVectorTy() && !Ty->isPtrOrPtrVectorTy() &&
+      !Ty->isFPOrFPVectorTy())
+    return std::nullopt;
+  return TTI.getRegisterClassForType(Ty->isVectorTy(), Ty);
+}
+
+// Per classe di registri TTI: valori definiti fuori dal loop e usati dentro,
+// PHI dell'header (vivi per tutto il loop) e picco di valori vivi in un blocco.
+// MyLICM ha un conteggio simile ma tiene il confronto di uscita, che resta nel
+// loop dopo lo hoisting; qui si salta perche' nel loop fuso ne resta uno solo.
+// I due pass si installano ciascuno da solo in llvm/lib/Transforms/Utils, per
+// questo il conteggio non sta in un file comune.
+namespace {
+struct RegisterUsage {
+  SmallPtrSet<const Value *, 16> LiveIns;
+  DenseMap<unsigned, unsigned> Through;
+  DenseMap<unsigned, unsigned> Peak;
+};
+} // namespace
+
+static RegisterUsage computeRegisterUsage(Loop *L, const TargetTransformInfo &TTI) {
+  RegisterUsage Usage;
+  // le PHI dell'header si contano solo in Through, non nel picco dei blocchi
+  auto IsHeaderPhi = [&](const Value *V) {
+    return isa<PHINode>(V) && cast<PHINode>(V)->getParent() == L->getHeader();
+  };
+  for (PHINode &Phi : L->getHeader()->phis())
+    if (auto Class = getRegisterClass(TTI, Phi.getType()))
+      ++Usage.Through[*Class];
+
+  ICmpInst *LatchCmp = L->getLatchCmpInst();
+  for (BasicBlock *BB : L->getBlocks()) {
+    // Scansione all'indietro: all'uscita sono vivi i valori usati in altri blocchi
+    SmallPtrSet<const Instruction *, 16> Live;
+    DenseMap<unsigned, unsigned> Count;
+    for (Instruction &I : *BB) {
+      auto Class = getRegisterClass(TTI, I.getType());
+      if (Class && &I != LatchCmp && !IsHeaderPhi(&I) &&
+          any_of(I.users(), [&](User *U) {
+            return cast<Instruction>(U)->getParent() != BB;
+          })) {
+        Live.insert(&I);
+        ++Count[*Class];
+      }
+    }
+
+    for (Instruction &I : reverse(*BB)) {
+      if (Live.erase(&I))
+        --Count[*getRegisterClass(TTI, I.getType())];
+      if (&I == LatchCmp || isa<PHINode>(&I))
+        continue;
+
+      for (Value *Op : I.operands()) {
+        auto Class = getRegisterClass(TTI, Op->getType());
+        if (!Class || IsHeaderPhi(Op))
+          continue;
+        auto *OpI = dyn_cast<Instruction>(Op);
+        if (isa<Argument>(Op) || (OpI && !L->contains(OpI)))
+          Usage.LiveIns.insert(Op);
+        else if (OpI && OpI->getParent() == BB && Live.insert(OpI).second)
+          ++Count[*Class];
+      }
+      for (auto &C : Count)
+        Usage.Peak[C.first] = std::max(Usage.Peak[C.first], C.second);
+    }
+  }
+  return Usage;
+}
+
+// Byte per iterazione scritti e riletti per i valori che non trovano un
+// registro nel loop fuso, oltre a quelli che mancavano già nei singoli loop.
+static uint64_t estimateSpillBytes(Loop *Lprev, Loop *Lnext, const TargetTransformInfo &TTI) {
+  const DataLayout &DL = Lprev->getHeader()->getModule()->getDataLayout();
+  RegisterUsage Prev = computeRegisterUsage(Lprev, TTI);
+  RegisterUsage Next = computeRegisterUsage(Lnext, TTI);
+
+  DenseMap<unsigned, unsigned> PrevIn, NextIn, FusedIn;
+  DenseMap<unsigned, uint64_t> RegBytes;
+  auto countLiveIns = [&](SmallPtrSetImpl<const Value *> &LiveIns,
+                          DenseMap<unsigned, unsigned> &Count) {
+    for (const Value *V : LiveIns) {
+      if (auto Class = getRegisterClass(TTI, V->getType())) {
+        ++Count[*Class];
+        RegBytes[*Class] = std::max<uint64_t>(RegBytes[*Class],
+                                              DL.getTypeStoreSize(V->getType()));
+      }
+    }
+  };
+  countLiveIns(Prev.LiveIns, PrevIn);
+  countLiveIns(Next.LiveIns, NextIn);
+  SmallPtrSet<const Value *, 16> Fused(Prev.LiveIns.begin(), Prev.LiveIns.end());
+  Fused.insert(Next.LiveIns.begin(), Next.LiveIns.end());
+  countLiveIns(Fused, FusedIn);
+
+  SmallSet<unsigned, 4> Classes;
+  for (auto *Count : {&Prev.Through, &Prev.Peak, &Next.Through, &Next.Peak, &FusedIn})
+    for (auto &C : *Count)
+      Classes.insert(C.first);
+
+  uint64_t Bytes = 0;
+  for (unsigned Class : Classes) {
+    unsigned PrevRegs = PrevIn[Class] + Prev.Through[Class] + Prev.Peak[Class];
+    unsigned NextRegs = NextIn[Class] + Next.Through[Class] + Next.Peak[Class];
+    // l'IV del secondo loop viene riscritta su quella del primo
+    unsigned SharedIV = Prev.Through[Class] && Next.Through[Class] ? 1 : 0;
+    unsigned FusedRegs = FusedIn[Class] + Prev.Through[Class] + Next.Through[Class] -
+                         SharedIV + std::max(Prev.Peak[Class], Next.Peak[Class]);
+    unsigned Limit = std::max({TTI.getNumberOfRegisters(Class), PrevRegs, NextRegs});
+    if (FusedRegs > Limit)
+      Bytes += 2 * (FusedRegs - Limit) * std::max<uint64_t>(RegBytes[Class], 8);
+  }
+  return Bytes;
+}
+
+// Byte per iterazione che il secondo loop legge o scrive su linee di cache
+// toccate dal primo poche iterazioni prima nel loop fuso: il riuso vale se i dati
+// passati nel frattempo (flussi distinti per oggetto e passo) stanno nella L1.
+static uint64_t estimateReuseBytes(Loop *Lprev, Loop *Lnext,
+                                   ArrayRef<Instruction *> PrevAccesses,
+                                   ArrayRef<Instruction *> NextAccesses,
+                                   ScalarEvolution &SE, const TargetTransformInfo &TTI) {
+  const DataLayout &DL = Lprev->getHeader()->getModule()->getDataLayout();
+  uint64_t LineSize = TTI.getCacheLineSize() ? TTI.getCacheLineSize() : 64;
+  uint64_t CacheSize =
+      TTI.getCacheSize(TargetTransformInfo::CacheLevel::L1D).value_or(32 * 1024);
+
+  SmallSet<std::pair<const Value *, uint64_t>, 8> Streams;
+  uint64_t Footprint = 0;
+  for (ArrayRef<Instruction *> Accesses : {PrevAccesses, NextAccesses}) {
+    for (Instruction *I : Accesses) {
+      Value *Ptr = getLoadStorePointerOperand(I);
+      uint64_t Stride = LineSize;
+      if (auto *Rec = dyn_cast<SCEVAddRecExpr>(SE.getSCEV(Ptr)))
+        if (auto *Step = dyn_cast<SCEVConstant>(Rec->getStepRecurrence(SE)))
+          Stride = std::min<uint64_t>(Step->getAPInt().abs().getLimitedValue(), LineSize);
+      if (Streams.insert({getUnderlyingObject(Ptr), Stride}).second)
+        Footprint += Stride;
+    }
+  }
+
+  int64_t PeelPrev = getPrevPeelCount(Lprev, Lnext, SE);
+  uint64_t Bytes = 0;
+  for (Instruction *J : NextAccesses) {
+    const Value *Obj = getUnderlyingObject(getLoadStorePointerOperand(J));
+    bool Reused = any_of(PrevAccesses, [&](Instruction *I) {
+      if (getUnderlyingObject(getLoadStorePointerOperand(I)) != Obj)
+        return false;
+      std::optional<int64_t> Distance = getFusedDistance(*I, *J, Lprev, Lnext, PeelPrev, SE);
+      return Distance && uint64_t(std::abs(*Distance)) * Footprint <= CacheSize;
+    });
+    if (Reused)
+      Bytes += DL.getTypeStoreSize(getLoadStoreType(J));
+  }
+  return Bytes;
+}
+
+// La fusione toglie sempre il controllo di un loop: si rinuncia solo quando il
+// loop fuso non ha abbastanza registri e gli spill costano più del riuso in cache.
+static bool isFusionProfitable(Loop *Lprev, Loop *Lnext, Function &F,
+                               FunctionAnalysisManager &FAM) {
+  if (!EnableCostModel)
+    return true;
+
+  const TargetTransformInfo &TTI = FAM.getResult<TargetIRAnalysis>(F);
+  uint64_t SpillBytes = estimateSpillBytes(Lprev, Lnext, TTI);
+  if (SpillBytes == 0)
+    return true;
+
+  ScalarEvolution &SE = FAM.getResult<ScalarEvolutionAnalysis>(F);
+  SmallVector<Instruction *, 16> PrevAccesses, NextAccesses;
+  collectMemoryAccesses(Lprev, PrevAccesses);
+  collectMemoryAccesses(Lnext, NextAccesses);
+  return estimateReuseBytes(Lprev, Lnext, PrevAccesses, NextAccesses, SE, TTI) >= SpillBytes;
+}
+
+// Forma prodotta dalla rotazione: il latch è l'unico blocco da cui si esce, con
+// un salto condizionato all'header o all'uscita.
+static bool isRotatedLoop(Loop *L) {
+  BasicBlock *Latch = L->getLoopLatch();
+  return Latch && L->getExitingBlock() == Latch && L->getExitBlock() &&
+         L->getLoopPreheader() && L->getLatchCmpInst();
+}
+
+// Forma for, non ruotata: si esce solo dall'header, con un salto condizionato
+// al corpo o all'uscita, e il latch torna all'header senza condizioni.
+static bool isForFormLoop(Loop *L) {
+  BasicBlock *Header = L->getHeader();
+  BasicBlock *Latch = L->getLoopLatch();
+  auto *HeaderBr = dyn_cast<BranchInst>(Header->getTerminator());
+  return Latch && Latch != Header && L->getExitingBlock() == Header && L->getExitBlock() &&
+         L->getLoopPreheader() && HeaderBr && HeaderBr->isConditional() &&
+         isa<ICmpInst>(HeaderBr->getCondition()) && Latch->getSingleSuccessor() == Header;
+}
+
+// Confronto che decide l'uscita: nel latch per i loop ruotati, nell'header per
+// quelli in forma for.
+static ICmpInst *getExitCmp(Loop *L) {
+  if (ICmpInst *Cmp = L->getLatchCmpInst())
+    return Cmp;
+  if (!isForFormLoop(L))
+    return nullptr;
+  return cast<ICmpInst>(cast<BranchInst>(L->getHeader()->getTerminator())->getCondition());
+}
+
+// merge sa unire due loop ruotati o due loop in forma for. Nella forma for
+// l'header del secondo diventa parte del corpo del loop fuso, eseguito solo se
+// il loop continua: non deve avere effetti collaterali, e i valori usati dopo
+// il loop devono essere PHI dell'header, che passano nell'header del primo.
+static bool haveMergeableForms(Loop *Lprev, Loop *Lnext) {
+  if (isRotatedLoop(Lprev) && isRotatedLoop(Lnext))
+    return true;
+  if (!isForFormLoop(Lprev) || !isForFormLoop(Lnext))
+    return false;
+
+  BasicBlock *NextHead = Lnext->getHeader();
+  if (any_of(*NextHead, [](Instruction &I) { return I.mayHaveSideEffects(); }))
+    return false;
+  return all_of(Lnext->getExitBlock()->phis(), [&](PHINode &Phi) {
+    auto *V = dyn_cast<Instruction>(Phi.getIncomingValueForBlock(NextHead));
+    return !V || !Lnext->contains(V) || (isa<PHINode>(V) && V->getParent() == NextHead);
+  });
+}
+
+// Il secondo loop, una volta fuso, viene eseguito dentro il primo: i valori
+// definiti fuori che usa devono essere disponibili prima del primo loop. Fa
+// eccezione il confronto di uscita, che sparisce con la fusione. Hoisted è il
+// codice tra i due loop che verrà portato prima del primo.
+static bool usesOnlyValuesBefore(Loop *Lprev, Loop *Lnext, DominatorTree &DT,
+                                 ArrayRef<Instruction *> Hoisted = {}) {
+  ICmpInst *NextCmp = getExitCmp(Lnext);
+  for (BasicBlock *BB : Lnext->blocks()) {
+    for (Instruction &I : *BB) {
+      if (&I == NextCmp)
+        continue;
+      for (Value *Op : I.operands()) {
+        auto *OpI = dyn_cast<Instruction>(Op);
+        if (OpI && !Lnext->contains(OpI) && !DT.dominates(OpI, Lprev->getHeader()) &&
+            !is_contained(Hoisted, OpI))
+          return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Blocchi rimasti irraggiungibili dopo il merge, cercati a partire da quelli
+// che hanno perso un predecessore: il DominatorTree già aggiornato non li
+// contiene più. Vengono tolti anche da LoopInfo (i loop interni li contengono
+// ancora).
+static void deleteUnreachableBlocks(ArrayRef<BasicBlock *> Candidates, LoopInfo &LI,
+                                    DomTreeUpdater &DTU) {
+  DominatorTree &DT = DTU.getDomTree();
+  SmallSetVector<BasicBlock *, 8> Dead;
+  SmallVector<BasicBlock *, 8> Worklist(Candidates.begin(), Candidates.end());
+  while (!Worklist.empty()) {
+    BasicBlock *BB = Worklist.pop_back_val();
+    if (DT.isReachableFromEntry(BB) || !Dead.insert(BB))
+      continue;
+    Worklist.append(succ_begin(BB), succ_end(BB));
+  }
+  for (BasicBlock *BB : Dead)
+    LI.removeBlock(BB);
+  DeleteDeadBlocks(Dead.getArrayRef(), &DTU);
+}
+
+// Quando il guard del primo loop salta il suo loop, salta sempre anche il guard
+// del secondo. PrevEnter e NextEnter sono i successori che entrano nei loop.
+static bool isSkipImplied(BranchInst *PrevGuard, BasicBlock *PrevEnter,
+                          BranchInst *NextGuard, BasicBlock *NextEnter) {
+  const DataLayout &DL = NextGuard->getModule()->getDataLayout();
+  bool PrevSkipsOnTrue = PrevGuard->getSuccessor(0) != PrevEnter;
+  bool NextSkipsOnTrue = NextGuard->getSuccessor(0) != NextEnter;
+  std::optional<bool> Implied = isImpliedCondition(PrevGuard->getCondition(),
+                                                   NextGuard->getCondition(), DL,
+                                                   PrevSkipsOnTrue);
+  return Implied && *Implied == NextSkipsOnTrue;
+}
+
+// Dopo il merge il guard del secondo loop, raggiunto dal percorso in cui il
+// guard del primo salta il loop fuso, entra direttamente nell'uscita del
+// secondo loop. Le PHI lì non hanno un valore su quel percorso (il loop che lo
+// calcolava non viene eseguito): se ce ne sono, si fonde solo se il percorso
+// non viene mai preso, cioè se il secondo guard salta sempre insieme al primo.
+// Between sono i blocchi tra i due loop che verranno uniti all'uscita del primo.
+static bool haveEquivalentGuards(Loop *Lprev, Loop *Lnext,
+                                 ArrayRef<BasicBlock *> Between = {}) {
+  BranchInst *NextGuard = Lnext->getLoopGuardBranch();
+  BasicBlock *NextExit = Lnext->getUniqueExitBlock();
+  if (!NextGuard || !NextExit || NextExit->phis().empty())
+    return true;
+
+  // se il secondo guard si raggiunge solo dall'uscita del primo, dopo il merge
+  // il suo blocco resta irraggiungibile
+  BasicBlock *PrevExit = Lprev->getUniqueExitBlock();
+  BranchInst *PrevGuard = Lprev->getLoopGuardBranch();
+  BasicBlock *PrevGuardBB = PrevGuard ? PrevGuard->getParent() : nullptr;
+  bool isSkipPathLive = false;
+  for (BasicBlock *Pred : predecessors(NextGuard->getParent())) {
+    if (Pred == PrevExit || is_contained(Between, Pred))
+      continue;
+    if (Pred != PrevGuardBB)
+      return false;
+    isSkipPathLive = true;
+  }
+  return !isSkipPathLive || isSkipImplied(PrevGuard, Lprev->getLoopPreheader(), NextGuard,
+                                          Lnext->getLoopPreheader());
+}
+
+// Dopo il merge il guard del secondo loop resta solo sul percorso in cui il
+// guard del primo salta il loop fuso. Se lì salta sempre anche lui è
+// ridondante: il primo guard salta direttamente dove saltava il secondo e il
+// blocco del secondo guard viene tolto. L'uscita del secondo loop resta con il
+// solo predecessore dell'uscita del primo e si unisce a questa, così il loop
+// fuso prosegue subito nel guard del loop successivo e resta adiacente.
+static void foldRedundantGuard(BranchInst *PrevGuard, BasicBlock *PrevPH,
+                               BranchInst *NextGuard, BasicBlock *NextExit,
+                               DomTreeUpdater &DTU, LoopInfo &LI) {
+  BasicBlock *PrevGuardBB = PrevGuard->getParent();
+  BasicBlock *NextGuardBB = NextGuard->getParent();
+  unsigned PrevSkipIdx = PrevGuard->getSuccessor(0) == PrevPH ? 1 : 0;
+  if (PrevGuard->getSuccessor(PrevSkipIdx) != NextGuardBB ||
+      NextGuardBB->getSinglePredecessor() != PrevGuardBB)
+    return;
+
+  // nel blocco c'è solo il calcolo della condizione, usata solo lì
+  for (Instruction &I : *NextGuardBB) {
+    if (&I == NextGuard)
+      continue;
+    if (isa<PHINode>(I) || I.mayHaveSideEffects() ||
+        any_of(I.users(), [&](User *U) {
+          return cast<Instruction>(U)->getParent() != NextGuardBB;
+        }))
+      return;
+  }
+
+  // con la condizione del primo guard che salta il loop, quella del secondo
+  // deve saltare il suo
+  if (!isSkipImplied(PrevGuard, PrevPH, NextGuard, NextExit))
+    return;
+
+  unsigned NextSkipIdx = NextGuard->getSuccessor(0) == NextExit ? 1 : 0;
+  BasicBlock *NextSkip = NextGuard->getSuccessor(NextSkipIdx);
+  for (PHINode &Phi : NextSkip->phis())
+    Phi.addIncoming(Phi.getIncomingValueForBlock(NextGuardBB), PrevGuardBB);
+  PrevGuard->setSuccessor(PrevSkipIdx, NextSkip);
+  DTU.applyUpdates({{DominatorTree::Insert, PrevGuardBB, NextSkip},
+                    {DominatorTree::Delete, PrevGuardBB, NextGuardBB}});
+  LI.removeBlock(NextGuardBB);
+  DeleteDeadBlock(NextGuardBB, &DTU);
+
+  MergeBlockIntoPredecessor(NextExit, &DTU, &LI);
+}
 
 BasicBlock *MyLoopFusion::getLoopHead(Loop *L) {
   return L->getLoopPreheader();
@@ -87,45 +834,53 @@ bool MyLoopFusion::areLoopsCFE(Loop *Lprev, Loop *Lnext, Function &F,
 }
 
 //verifica trip count
+// I trip count sono equivalenti se sono uguali o se differiscono di una costante
+// che si può togliere con il peeling prima di fondere. L'IV del secondo loop
+// deve poter essere riscritta in funzione del primo: può avere valore iniziale
+// e passo diversi.
 bool MyLoopFusion::areLoopsTCE(Loop *Lprev, Loop *Lnext, Function &F,
                                FunctionAnalysisManager &FAM) {
 
   ScalarEvolution &SE = FAM.getResult<ScalarEvolutionAnalysis>(F);
-  auto PrevTC = SE.getBackedgeTakenCount(Lprev);
-  auto NextTC = SE.getBackedgeTakenCount(Lnext);
-
-  if (isa<SCEVCouldNotCompute>(PrevTC) || isa<SCEVCouldNotCompute>(NextTC)) {
+  DominatorTree &DT = FAM.getResult<DominatorTreeAnalysis>(F);
+  std::optional<int64_t> Diff = getTripCountDifference(Lprev, Lnext, SE);
+  if (!Diff || !canAlignTripCounts(Lprev, Lnext, *Diff, DT, SE))
     return false;
-  } else if (SE.isKnownPredicate(CmpInst::ICMP_EQ, PrevTC, NextTC)) {
-    return true;
-  }
 
-  return false;
+  PHINode *PrevIV = getInductionVariable(Lprev, SE);
+  PHINode *NextIV = getInductionVariable(Lnext, SE);
+  return PrevIV && NextIV && canRewriteInductionVariable(Lprev, NextIV, SE);
 }
 
 //verifico assenza di dipendenze 
+// La fusione è legale se non inverte nessuna dipendenza tra un accesso del primo
+// loop e uno del secondo: nel loop fuso l'iterazione del secondo non deve venire
+// prima di quella del primo (nella stessa iterazione il corpo del primo precede
+// quello del secondo). DependenceInfo dice se la dipendenza esiste e la sua
+// direzione sui loop che contengono entrambi; la distanza tra due loop fratelli,
+// che DependenceInfo non calcola, viene dagli indirizzi SCEV.
 bool MyLoopFusion::areLoopsIndependent(Loop *Lprev, Loop *Lnext, Function &F,
                                        FunctionAnalysisManager &FAM) {
   DependenceInfo &DI = FAM.getResult<DependenceAnalysis>(F);
+  ScalarEvolution &SE = FAM.getResult<ScalarEvolutionAnalysis>(F);
 
-  // Se ci sono load/store, verifica dipendenze anti per evitare fusioni errate.
-  for (auto *BB : Lprev->getBlocks()) {
-    for (auto &I : *BB) {
-      if (isa<LoadInst>(&I) || isa<StoreInst>(&I)) {
-        for (auto *BB2 : Lnext->getBlocks()) {
-          for (auto &I2 : *BB2) {
-            if (isa<LoadInst>(&I2) || isa<StoreInst>(&I2)) {
-              auto Dep = DI.depends(&I, &I2, true);
-              if (Dep) {
-                // Se la dipendenza non è "confused" ed è anti, evito il merge.
-                if (!Dep->isConfused() && Dep->isAnti()) {
-                  return false;
-                }
-              }
-            }
-          }
-        }
-      }
+  SmallVector<Instruction *, 16> PrevAccesses, NextAccesses;
+  if (!collectMemoryAccesses(Lprev, PrevAccesses) ||
+      !collectMemoryAccesses(Lnext, NextAccesses))
+    return false;
+
+  int64_t PeelPrev = getPrevPeelCount(Lprev, Lnext, SE);
+  for (Instruction *I : PrevAccesses) {
+    for (Instruction *J : NextAccesses) {
+      if (isa<LoadInst>(I) && isa<LoadInst>(J))
+        continue;
+      auto Dep = DI.depends(I, J, true);
+      if (!Dep || isCarriedByCommonLoop(*Dep))
+        continue;
+
+      std::optional<int64_t> Distance = getFusedDistance(*I, *J, Lprev, Lnext, PeelPrev, SE);
+      if (!Distance || *Distance < 0)
+        return false;
     }
   }
 
@@ -139,188 +894,937 @@ PHINode *MyLoopFusion::getInductionVariable(Loop *L, ScalarEvolution &SE) {
   return L->getCanonicalInductionVariable();
 }
 
-// Unisce due cicli
+// Unisce due cicli: il corpo del secondo viene eseguito, in ogni iterazione,
+// dopo quello del primo, qualunque sia il flusso di controllo al suo interno.
+// Loop ruotati (il latch è l'unico blocco di uscita, come quelli di clang): il
+// latch del primo prosegue nell'header del secondo e il latch del secondo prende
+// il salto di uscita del primo. Loop in forma for (si esce dall'header): il latch
+// del primo prosegue nell'header del secondo, che non esce più, e il latch del
+// secondo torna all'header del primo. LoopInfo, DominatorTree e ScalarEvolution
+// vengono aggiornati qui, senza ricalcolarli.
 Loop *MyLoopFusion::merge(Loop *Lprev, Loop *Lnext, Function &F,
                           FunctionAnalysisManager &FAM) {
   ScalarEvolution &SE = FAM.getResult<ScalarEvolutionAnalysis>(F);
   LoopInfo &LI = FAM.getResult<LoopAnalysis>(F);
+  DominatorTree &DT = FAM.getResult<DominatorTreeAnalysis>(F);
 
-  // Caso semplice: loop a blocco singolo (header == latch), come nei test base.
-  if (Lprev->getHeader() == Lprev->getLoopLatch() &&
-      Lnext->getHeader() == Lnext->getLoopLatch()) {
-    BasicBlock *PrevHead = Lprev->getHeader();
-    BasicBlock *NextHead = Lnext->getHeader();
-    BasicBlock *PrevExit = getLoopExit(Lprev);
-    BasicBlock *NextExit = getLoopExit(Lnext);
-    BasicBlock *NextPH = Lnext->getLoopPreheader();
-    BranchInst *NextGuard = Lnext->getLoopGuardBranch();
-
-    auto PrevIV = getInductionVariable(Lprev, SE);
-    auto NextIV = getInductionVariable(Lnext, SE);
-    if (!PrevIV || !NextIV || !PrevExit || !NextExit || !NextPH)
-      return Lprev;
-
-    ICmpInst *PrevCmp = Lprev->getLatchCmpInst();
-    ICmpInst *NextCmp = Lnext->getLatchCmpInst();
-    Instruction *NextStep = nullptr;
-    if (auto Bounds = Loop::LoopBounds::getBounds(*Lnext, *NextIV, SE)) {
-      NextStep = &Bounds->getStepInst();
-    }
+  bool isRotated = isRotatedLoop(Lprev) && isRotatedLoop(Lnext);
+  if (!isRotated && !(isForFormLoop(Lprev) && isForFormLoop(Lnext)))
+    return Lprev;
 
-    NextIV->replaceAllUsesWith(PrevIV);
-    NextIV->eraseFromParent();
+  BasicBlock *PrevHead = Lprev->getHeader();
+  BasicBlock *PrevLatch = Lprev->getLoopLatch();
+  BasicBlock *PrevPH = Lprev->getLoopPreheader();
+  BasicBlock *PrevExit = getLoopExit(Lprev);
+  BasicBlock *NextHead = Lnext->getHeader();
+  BasicBlock *NextLatch = Lnext->getLoopLatch();
+  BasicBlock *NextPH = Lnext->getLoopPreheader();
+  BasicBlock *NextExit = getLoopExit(Lnext);
+  BasicBlock *NextExiting = isRotated ? NextLatch : NextHead;
+  BranchInst *PrevGuard = Lprev->getLoopGuardBranch();
+  BranchInst *NextGuard = Lnext->getLoopGuardBranch();
+  bool isSingleBlock = isRotated && PrevHead == PrevLatch && NextHead == NextLatch;
+
+  auto PrevIV = getInductionVariable(Lprev, SE);
+  auto NextIV = getInductionVariable(Lnext, SE);
+  if (!PrevIV || !NextIV || !PrevExit || !NextExit || !NextPH)
+    return Lprev;
+
+  ICmpInst *PrevCmp = getExitCmp(Lprev);
+  ICmpInst *NextCmp = getExitCmp(Lnext);
+  Instruction *NextStep = nullptr;
+  if (auto Bounds = Loop::LoopBounds::getBounds(*Lnext, *NextIV, SE)) {
+    NextStep = &Bounds->getStepInst();
+  }
+  Value *NextStart = NextIV->getIncomingValueForBlock(NextPH);
+
+  // Successori dei blocchi di cui cambia il terminatore, per aggiornare il
+  // DominatorTree con la differenza alla fine
+  SmallSetVector<BasicBlock *, 8> Rewired;
+  Rewired.insert(PrevLatch);
+  Rewired.insert(NextHead);
+  Rewired.insert(NextLatch);
+  Rewired.insert(PrevExit);
+  Rewired.insert(NextPH);
+  if (NextGuard)
+    Rewired.insert(NextGuard->getParent());
+  SmallDenseMap<BasicBlock *, SmallPtrSet<BasicBlock *, 2>, 8> OldSuccs;
+  for (BasicBlock *BB : Rewired)
+    OldSuccs[BB].insert(succ_begin(BB), succ_end(BB));
+
+  replaceInductionVariable(Lprev, PrevIV, NextIV, SE);
 
+  // Le altre PHI del secondo header (per esempio le riduzioni) passano nel
+  // primo: il valore iniziale arriva dal preheader del primo loop.
+  for (PHINode &Phi : make_early_inc_range(NextHead->phis())) {
+    Phi.replaceIncomingBlockWith(NextPH, PrevPH);
+    if (isSingleBlock)
+      Phi.replaceIncomingBlockWith(NextLatch, PrevLatch);
+    Phi.moveBefore(PrevHead->getFirstNonPHI());
+  }
+
+  if (isSingleBlock) {
     Instruction *InsertPoint = PrevCmp ? PrevCmp : PrevHead->getTerminator();
     SmallVector<Instruction *, 8> ToMove;
     for (Instruction &I : *NextHead) {
       if (isa<PHINode>(&I) || I.isTerminator())
         continue;
-      if (&I == NextCmp || &I == NextStep)
+      if (&I == NextCmp)
+        continue;
+      // l'incremento dell'IV serve solo se è usato anche fuori dal confronto di uscita
+      if (&I == NextStep &&
+          all_of(I.users(), [&](User *U) { return U == NextCmp; }))
         continue;
       ToMove.push_back(&I);
     }
     for (Instruction *I : ToMove)
       I->moveBefore(InsertPoint);
+  } else if (isRotated) {
+    // Il latch del primo prosegue nel corpo del secondo; il latch del secondo
+    // diventa quello del loop fuso, con il salto di uscita del primo.
+    Instruction *PrevTerm = PrevLatch->getTerminator();
+    PrevTerm->removeFromParent();
+    BranchInst::Create(NextHead, PrevLatch);
+    NextLatch->getTerminator()->eraseFromParent();
+    PrevTerm->insertInto(NextLatch, NextLatch->end());
+    for (PHINode &Phi : PrevExit->phis())
+      Phi.replaceIncomingBlockWith(PrevLatch, NextLatch);
+  } else {
+    // L'header del secondo non esce più: prosegue sempre nel suo corpo.
+    auto *NextTerm = cast<BranchInst>(NextHead->getTerminator());
+    unsigned BodyIdx = Lnext->contains(NextTerm->getSuccessor(0)) ? 0 : 1;
+    BasicBlock *NextBody = NextTerm->getSuccessor(BodyIdx);
+    BranchInst::Create(NextBody, NextTerm);
+    NextTerm->eraseFromParent();
+    PrevLatch->getTerminator()->replaceSuccessorWith(PrevHead, NextHead);
+    NextLatch->getTerminator()->replaceSuccessorWith(NextHead, PrevHead);
+  }
+  if (!isSingleBlock)
+    for (PHINode &Phi : PrevHead->phis())
+      Phi.replaceIncomingBlockWith(PrevLatch, NextLatch);
 
-    // Salta completamente il secondo loop.
-    if (PrevExit) {
-      auto *T = PrevExit->getTerminator();
-      for (unsigned i = 0, e = T->getNumSuccessors(); i != e; ++i) {
-        if (T->getSuccessor(i) == (NextGuard ? NextGuard->getParent() : NextPH) ||
-            T->getSuccessor(i) == NextPH) {
-          T->setSuccessor(i, NextExit);
-        }
+  // Salta completamente il secondo loop.
+  if (PrevExit) {
+    auto *T = PrevExit->getTerminator();
+    for (unsigned i = 0, e = T->getNumSuccessors(); i != e; ++i) {
+      if (T->getSuccessor(i) == (NextGuard ? NextGuard->getParent() : NextPH) ||
+          T->getSuccessor(i) == NextPH) {
+        T->setSuccessor(i, NextExit);
       }
     }
-    if (NextGuard) {
-      for (unsigned i = 0, e = NextGuard->getNumSuccessors(); i != e; ++i) {
-        if (NextGuard->getSuccessor(i) == NextPH)
-          NextGuard->setSuccessor(i, NextExit);
+  }
+  if (NextGuard) {
+    for (unsigned i = 0, e = NextGuard->getNumSuccessors(); i != e; ++i) {
+      if (NextGuard->getSuccessor(i) == NextPH)
+        NextGuard->setSuccessor(i, NextExit);
+    }
+  }
+  if (NextPH) {
+    auto *T = NextPH->getTerminator();
+    for (unsigned i = 0, e = T->getNumSuccessors(); i != e; ++i) {
+      if (T->getSuccessor(i) == NextHead)
+        T->setSuccessor(i, NextExit);
+    }
+  }
+
+  // PHI nell'uscita del secondo loop (per esempio il punto di ripartenza del
+  // resto dopo il peeling in coda): dopo l'uscita del loop fuso vale quanto
+  // calcolato nel loop fuso, sui percorsi in cui il primo loop non viene
+  // eseguito vale il valore iniziale dell'IV. Per gli altri valori si usa
+  // poison: haveEquivalentGuards ha dimostrato che su quei percorsi anche il
+  // secondo guard salta il suo loop, quindi l'arco non viene mai preso.
+  auto *StartInst = dyn_cast<Instruction>(NextStart);
+  BasicBlock *StartBB = StartInst ? StartInst->getParent() : &F.getEntryBlock();
+  for (PHINode &Phi : NextExit->phis()) {
+    Value *V = Phi.getIncomingValueForBlock(NextExiting);
+    bool isIVExit = V == NextStep && StartBB != NextPH;
+    SSAUpdater SSA;
+    SSA.Initialize(V->getType(), Phi.getName());
+    SSA.AddAvailableValue(PrevExit, V);
+    SSA.AddAvailableValue(StartBB, isIVExit ? NextStart : PoisonValue::get(V->getType()));
+    for (BasicBlock *Pred : predecessors(NextExit)) {
+      if (Pred != NextExiting && Phi.getBasicBlockIndex(Pred) < 0)
+        Phi.addIncoming(SSA.GetValueAtEndOfBlock(Pred), Pred);
+    }
+    if (!isSingleBlock)
+      Phi.removeIncomingValue(NextExiting, false);
+  }
+
+  // il confronto di uscita del secondo loop sparisce con il suo header:
+  // si tolgono anche i valori calcolati solo per quello
+  SmallVector<WeakTrackingVH, 2> CmpOperands;
+  if (NextCmp)
+    CmpOperands.append(NextCmp->op_begin(), NextCmp->op_end());
+
+  SE.forgetLoop(Lnext);
+  if (isSingleBlock) {
+    LI.erase(Lnext);
+  } else {
+    // I blocchi e i loop interni del secondo passano al primo
+    for (BasicBlock *BB : Lnext->blocks()) {
+      Lprev->addBlockEntry(BB);
+      if (LI.getLoopFor(BB) == Lnext)
+        LI.changeLoopFor(BB, Lprev);
+    }
+    while (!Lnext->isInnermost()) {
+      Loop *Child = *Lnext->begin();
+      Lnext->removeChildLoop(Lnext->begin());
+      Lprev->addChildLoop(Child);
+    }
+    LI.erase(Lnext);
+    RecursivelyDeleteTriviallyDeadInstructions(NextCmp);
+  }
+
+  // Archi tolti e aggiunti dai nuovi terminatori; i blocchi che hanno perso un
+  // predecessore possono essere diventati irraggiungibili.
+  DomTreeUpdater DTU(DT, DomTreeUpdater::UpdateStrategy::Eager);
+  SmallVector<DominatorTree::UpdateType, 16> Updates;
+  SmallVector<BasicBlock *, 8> LostPred;
+  for (BasicBlock *BB : Rewired) {
+    SmallPtrSet<BasicBlock *, 2> NewSuccs(succ_begin(BB), succ_end(BB));
+    for (BasicBlock *Succ : OldSuccs[BB])
+      if (!NewSuccs.count(Succ)) {
+        Updates.push_back({DominatorTree::Delete, BB, Succ});
+        LostPred.push_back(Succ);
+      }
+    for (BasicBlock *Succ : NewSuccs)
+      if (!OldSuccs[BB].count(Succ))
+        Updates.push_back({DominatorTree::Insert, BB, Succ});
+  }
+  DTU.applyUpdates(Updates);
+  deleteUnreachableBlocks(LostPred, LI, DTU);
+  if (PrevGuard && NextGuard)
+    foldRedundantGuard(PrevGuard, PrevPH, NextGuard, NextExit, DTU, LI);
+
+  // il latch del primo e l'header del secondo diventano un blocco solo: se il
+  // secondo era un nido, il suo loop interno segue subito quello del primo
+  if (!isSingleBlock)
+    MergeBlockIntoPredecessor(NextHead, &DTU, &LI);
+  for (WeakTrackingVH &V : CmpOperands)
+    RecursivelyDeleteTriviallyDeadInstructions(V);
+  SE.forgetLoop(Lprev);
+  // le PHI dell'uscita del secondo loop ora ricevono valori del loop fuso
+  formLCSSARecursively(*Lprev, DT, &LI, &SE);
+  return Lprev;
+}
+
+// Usi di un array locale (alloca o malloc senza alias): accessi nel loop L,
+// puntatori derivati, marker di lifetime e free. Qualsiasi altro uso, o un
+// accesso fuori dal loop, lo rende vivo dopo la fusione.
+static bool collectArrayUses(Instruction *Obj, Loop *L, const TargetLibraryInfo &TLI,
+                             SmallSetVector<Instruction *, 8> &Users,
+                             SmallVectorImpl<LoadInst *> &Loads,
+                             SmallVectorImpl<StoreInst *> &Stores) {
+  SmallVector<Instruction *, 8> Worklist = {Obj};
+  while (!Worklist.empty()) {
+    Instruction *Ptr = Worklist.pop_back_val();
+    for (User *U : Ptr->users()) {
+      auto *I = cast<Instruction>(U);
+      if (auto *Ld = dyn_cast<LoadInst>(I)) {
+        if (!Ld->isSimple() || !L->contains(Ld))
+          return false;
+        Loads.push_back(Ld);
+      } else if (auto *St = dyn_cast<StoreInst>(I)) {
+        if (!St->isSimple() || St->getValueOperand() == Ptr || !L->contains(St))
+          return false;
+        Stores.push_back(St);
+      } else if (isa<GetElementPtrInst>(I) || isa<BitCastInst>(I)) {
+        if (Users.insert(I))
+          Worklist.push_back(I);
+      } else if (I->isLifetimeStartOrEnd() ||
+                 (isa<CallBase>(I) && getFreedOperand(cast<CallBase>(I), &TLI) == Ptr)) {
+        Users.insert(I);
+      } else {
+        return false;
       }
     }
-    if (NextPH) {
-      auto *T = NextPH->getTerminator();
-      for (unsigned i = 0, e = T->getNumSuccessors(); i != e; ++i) {
-        if (T->getSuccessor(i) == NextHead)
-          T->setSuccessor(i, NextExit);
+  }
+  return true;
+}
+
+// Contrazione degli array temporanei nel loop fuso: se un array locale viene
+// scritto da un solo store e letto solo dopo di esso nella stessa iterazione,
+// allo stesso indirizzo, ogni load legge il valore appena scritto. I load
+// vengono sostituiti da quel valore e l'array, che nessuno legge più, viene
+// tolto insieme alla sua allocazione.
+static bool contractArrays(Loop *L, Function &F, FunctionAnalysisManager &FAM) {
+  ScalarEvolution &SE = FAM.getResult<ScalarEvolutionAnalysis>(F);
+  LoopInfo &LI = FAM.getResult<LoopAnalysis>(F);
+  DominatorTree &DT = FAM.getResult<DominatorTreeAnalysis>(F);
+  const TargetLibraryInfo &TLI = FAM.getResult<TargetLibraryAnalysis>(F);
+
+  SmallSetVector<Instruction *, 4> Objects;
+  for (BasicBlock *BB : L->blocks())
+    for (Instruction &I : *BB)
+      if (Value *Ptr = getLoadStorePointerOperand(&I)) {
+        auto *Obj = dyn_cast<Instruction>(getUnderlyingObject(Ptr));
+        if (Obj && (isa<AllocaInst>(Obj) || (isNoAliasCall(Obj) && isAllocLikeFn(Obj, &TLI))))
+          Objects.insert(Obj);
       }
+
+  bool Changed = false;
+  for (Instruction *Obj : Objects) {
+    SmallSetVector<Instruction *, 8> Users;
+    SmallVector<LoadInst *, 4> Loads;
+    SmallVector<StoreInst *, 2> Stores;
+    if (!collectArrayUses(Obj, L, TLI, Users, Loads, Stores) || Stores.size() != 1)
+      continue;
+
+    // Lo store domina il load, quindi nello stesso loop viene eseguito prima
+    // nella stessa iterazione; con lo stesso SCEV l'indirizzo è lo stesso
+    StoreInst *Store = Stores.front();
+    Value *Val = Store->getValueOperand();
+    const SCEV *Addr = SE.getSCEV(Store->getPointerOperand());
+    bool isContractible = all_of(Loads, [&](LoadInst *Ld) {
+      return Ld->getType() == Val->getType() && SE.getSCEV(Ld->getPointerOperand()) == Addr &&
+             DT.dominates(Store, Ld);
+    });
+    if (!isContractible)
+      continue;
+
+    for (LoadInst *Ld : Loads) {
+      Ld->replaceAllUsesWith(Val);
+      Ld->eraseFromParent();
     }
+    Store->eraseFromParent();
+    // ogni puntatore derivato viene raccolto prima dei suoi usi
+    for (Instruction *I : reverse(Users))
+      I->eraseFromParent();
+    Obj->eraseFromParent();
+    ++NumContracted;
+    Changed = true;
+  }
+  // un load fuori dal loop interno dello store ora usa un valore di quel loop
+  if (Changed) {
+    SE.forgetLoop(L);
+    formLCSSARecursively(*L, DT, &LI, &SE);
+  }
+  return Changed;
+}
 
-    LI.erase(Lnext);
-    EliminateUnreachableBlocks(F);
-    return Lprev;
+// Regione di un loop in una sequenza di loop fratelli: dal guard (o dal
+// preheader) al blocco in cui i percorsi si riuniscono dopo l'uscita. In Entry la
+// regione comincia da Begin (la condizione del guard o il salto al loop): le
+// istruzioni prima appartengono alla regione precedente.
+namespace {
+struct LoopRegion {
+  BasicBlock *Entry;
+  Instruction *Begin;
+  BasicBlock *End;
+};
+} // namespace
+
+static std::optional<LoopRegion> getLoopRegion(Loop *L) {
+  BasicBlock *PH = L->getLoopPreheader();
+  BasicBlock *Exit = L->getExitBlock();
+  if (!PH || !Exit || !isRotatedLoop(L))
+    return std::nullopt;
+
+  BranchInst *Guard = L->getLoopGuardBranch();
+  if (!Guard)
+    return LoopRegion{PH, PH->getTerminator(), Exit};
+
+  // il guard salta al blocco dopo l'uscita, in cui arrivano solo i due percorsi
+  BasicBlock *GuardBB = Guard->getParent();
+  BasicBlock *End = Exit->getUniqueSuccessor();
+  if (!End || !all_of(predecessors(End),
+                      [&](BasicBlock *Pred) { return Pred == Exit || Pred == GuardBB; }))
+    return std::nullopt;
+  auto *Cond = dyn_cast<Instruction>(Guard->getCondition());
+  Instruction *Begin =
+      Cond && Cond->getParent() == GuardBB && Cond->hasOneUse() ? Cond : Guard;
+  return LoopRegion{GuardBB, Begin, End};
+}
+
+// Istruzioni della regione: da Begin fino a NextBegin, l'inizio della regione
+// che segue nel blocco di riunione.
+static void collectRegionInstructions(Loop *L, const LoopRegion &R, Instruction *NextBegin,
+                                      SmallVectorImpl<Instruction *> &Insts) {
+  for (Instruction *I = R.Begin; I; I = I->getNextNode())
+    Insts.push_back(I);
+  SmallPtrSet<BasicBlock *, 8> Blocks(L->block_begin(), L->block_end());
+  Blocks.insert(L->getLoopPreheader());
+  Blocks.insert(L->getExitBlock());
+  Blocks.erase(R.Entry);
+  Blocks.erase(R.End);
+  for (BasicBlock *BB : Blocks)
+    for (Instruction &I : *BB)
+      Insts.push_back(&I);
+  for (Instruction &I : *R.End) {
+    if (&I == NextBegin)
+      break;
+    Insts.push_back(&I);
   }
+}
 
-  BasicBlock *PrevLatch = Lprev->getLoopLatch();
-  BasicBlock *PrevBody = PrevLatch->getSinglePredecessor();
-  BasicBlock *PrevHead = Lprev->getHeader();
-  BasicBlock *PrevPH = Lprev->getLoopPreheader();
-  BasicBlock *PrevExit = Lprev->getExitBlock();
-  BranchInst *PrevGuard = Lprev->getLoopGuardBranch();
+// Ordine tra due regioni: la seconda usa un valore della prima, o c'è una
+// dipendenza in memoria tra un accesso della prima e uno della seconda.
+static bool regionsDepend(ArrayRef<Instruction *> First, ArrayRef<Instruction *> Second,
+                          DependenceInfo &DI) {
+  SmallPtrSet<Instruction *, 32> Defs(First.begin(), First.end());
+  for (Instruction *I : Second)
+    for (Value *Op : I->operands())
+      if (Defs.count(dyn_cast<Instruction>(Op)))
+        return true;
 
-  BasicBlock *NextLatch = Lnext->getLoopLatch();
-  BasicBlock *NextBody = NextLatch->getSinglePredecessor();
-  BasicBlock *NextHead = Lnext->getHeader();
-  BasicBlock *NextPH = Lnext->getLoopPreheader();
-  BasicBlock *NextExit = Lnext->getExitBlock();
+  for (Instruction *I : First) {
+    if (!I->mayReadOrWriteMemory())
+      continue;
+    for (Instruction *J : Second) {
+      if (!J->mayReadOrWriteMemory() || (!I->mayWriteToMemory() && !J->mayWriteToMemory()))
+        continue;
+      if (!isa<LoadInst>(I) && !isa<StoreInst>(I))
+        return true;
+      if (!isa<LoadInst>(J) && !isa<StoreInst>(J))
+        return true;
+      if (DI.depends(I, J, true))
+        return true;
+    }
+  }
+  return false;
+}
 
-  auto PrevIV = getInductionVariable(Lprev, SE);
-  auto NextIV = getInductionVariable(Lnext, SE);
+// Sposta la regione di Lnext, che segue subito quella di Lprev, prima di essa.
+// Le due regioni vengono staccate dai blocchi di confine e ricollegate in
+// ordine inverso, poi i blocchi di confine vengono riuniti.
+static void swapRegions(Loop *Lprev, Loop *Lnext, Instruction *NextBegin, LoopInfo &LI,
+                        DominatorTree &DT, ScalarEvolution &SE) {
+  LoopRegion First = *getLoopRegion(Lprev);
+  LoopRegion Second = *getLoopRegion(Lnext);
+  BasicBlock *Tail = Second.End;
+  if (!NextBegin)
+    NextBegin = Tail->getFirstNonPHI();
 
-  if (!PrevIV || !NextIV)
-    return Lprev;
+  BasicBlock *FirstBegin = SplitBlock(First.Entry, First.Begin, &DT, &LI);
+  BasicBlock *SecondBegin = SplitBlock(Second.Entry, Second.Begin, &DT, &LI);
+  if (Tail == Second.Entry)
+    Tail = SecondBegin;
+  BasicBlock *After = SplitBlock(Tail, NextBegin, &DT, &LI);
 
-  // Rimpiazza l'IV del secondo con quella del primo.
-  NextIV->replaceAllUsesWith(PrevIV);
-  NextIV->eraseFromParent();
+  First.Entry->getTerminator()->replaceSuccessorWith(FirstBegin, SecondBegin);
+  Second.Entry->getTerminator()->replaceSuccessorWith(SecondBegin, After);
+  Tail->getTerminator()->replaceSuccessorWith(After, FirstBegin);
+  DomTreeUpdater DTU(DT, DomTreeUpdater::UpdateStrategy::Eager);
+  DTU.applyUpdates({{DominatorTree::Delete, First.Entry, FirstBegin},
+                    {DominatorTree::Insert, First.Entry, SecondBegin},
+                    {DominatorTree::Delete, Second.Entry, SecondBegin},
+                    {DominatorTree::Insert, Second.Entry, After},
+                    {DominatorTree::Delete, Tail, After},
+                    {DominatorTree::Insert, Tail, FirstBegin}});
 
-  // Sposta i PHI del secondo header nel primo, fixando i blocchi incoming.
-  // Serve a gestire casi come a++ con a dichiarata fuori dai loop.
-  
-  // Prendi tutti i PHINodes nel NextHead.
-  SmallVector<PHINode *, 8> PHIsToMove;
-  for (Instruction &I : *NextHead) {
-    if (PHINode *PHI = dyn_cast<PHINode>(&I)) {
-      PHIsToMove.push_back(PHI);
+  MergeBlockIntoPredecessor(SecondBegin, &DTU, &LI);
+  MergeBlockIntoPredecessor(FirstBegin, &DTU, &LI);
+  MergeBlockIntoPredecessor(After, &DTU, &LI);
+  SE.forgetLoop(Lprev);
+  SE.forgetLoop(Lnext);
+  ++NumReordered;
+}
+
+// Grafo di fusione alla Kennedy-McKinley per una catena di loop fratelli, in cui
+// ogni regione segue subito la precedente. Archi di ordine dove c'è una
+// dipendenza, archi di fusione (pesati con il riuso) tra i loop che si possono
+// fondere. Le partizioni si uniscono partendo dall'arco più pesante, portando
+// dentro i loop su un cammino di dipendenze tra le due (altrimenti il grafo delle
+// partizioni avrebbe un ciclo); tutti i loop di una partizione devono potersi
+// fondere a due a due. Restituisce l'ordine dei loop, con le partizioni in ordine
+// topologico e contigue.
+static SmallVector<unsigned, 8> partitionLoops(MyLoopFusion &Pass, ArrayRef<Loop *> Chain,
+                                               Function &F, FunctionAnalysisManager &FAM) {
+  DependenceInfo &DI = FAM.getResult<DependenceAnalysis>(F);
+  ScalarEvolution &SE = FAM.getResult<ScalarEvolutionAnalysis>(F);
+  DominatorTree &DT = FAM.getResult<DominatorTreeAnalysis>(F);
+  const TargetTransformInfo &TTI = FAM.getResult<TargetIRAnalysis>(F);
+  unsigned N = Chain.size();
+
+  SmallVector<SmallVector<Instruction *, 32>, 8> Insts(N);
+  for (unsigned i = 0; i != N; ++i) {
+    Instruction *NextBegin = i + 1 < N ? getLoopRegion(Chain[i + 1])->Begin : nullptr;
+    LoopRegion R = *getLoopRegion(Chain[i]);
+    collectRegionInstructions(Chain[i], R, NextBegin ? NextBegin : R.End->getFirstNonPHI(),
+                              Insts[i]);
+  }
+
+  SmallVector<SmallVector<bool, 8>, 8> Dep(N, SmallVector<bool, 8>(N, false));
+  SmallVector<SmallVector<bool, 8>, 8> Fusible(N, SmallVector<bool, 8>(N, false));
+  struct FusionEdge { unsigned From, To; uint64_t Weight; };
+  SmallVector<FusionEdge, 16> Edges;
+  for (unsigned i = 0; i != N; ++i) {
+    for (unsigned j = i + 1; j != N; ++j) {
+      Dep[i][j] = regionsDepend(Insts[i], Insts[j], DI);
+      Fusible[i][j] = usesOnlyValuesBefore(Chain[i], Chain[j], DT) &&
+                      Pass.areLoopsTCE(Chain[i], Chain[j], F, FAM) &&
+                      Pass.areLoopsIndependent(Chain[i], Chain[j], F, FAM) &&
+                      isFusionProfitable(Chain[i], Chain[j], F, FAM);
+      if (!Fusible[i][j])
+        continue;
+      // la fusione toglie comunque il controllo di un loop: peso minimo 1
+      SmallVector<Instruction *, 16> PrevAccesses, NextAccesses;
+      collectMemoryAccesses(Chain[i], PrevAccesses);
+      collectMemoryAccesses(Chain[j], NextAccesses);
+      Edges.push_back({i, j, 1 + estimateReuseBytes(Chain[i], Chain[j], PrevAccesses,
+                                                    NextAccesses, SE, TTI)});
     }
   }
+  llvm::stable_sort(Edges, [](const FusionEdge &A, const FusionEdge &B) {
+    return A.Weight > B.Weight;
+  });
+
+  SmallVector<unsigned, 8> Part(N);
+  for (unsigned i = 0; i != N; ++i)
+    Part[i] = i;
+
+  // cammino di dipendenze dalla partizione From alla partizione To
+  auto reaches = [&](unsigned From, unsigned To) {
+    SmallVector<bool, 8> Seen(N, false);
+    SmallVector<unsigned, 8> Worklist = {From};
+    Seen[From] = true;
+    while (!Worklist.empty()) {
+      unsigned P = Worklist.pop_back_val();
+      for (unsigned u = 0; u != N; ++u) {
+        if (Part[u] != P)
+          continue;
+        for (unsigned v = u + 1; v != N; ++v) {
+          if (!Dep[u][v] || Part[v] == P)
+            continue;
+          if (Part[v] == To)
+            return true;
+          if (!Seen[Part[v]]) {
+            Seen[Part[v]] = true;
+            Worklist.push_back(Part[v]);
+          }
+        }
+      }
+    }
+    return false;
+  };
 
-  // Punto di inserimento: prima istruzione non-PHI del PrevHead.
-  Instruction *InsertPoint = PrevHead->getFirstNonPHI();
-  // Modifica gli incoming block dei PHI spostati.
-  for (PHINode *PHI : PHIsToMove) {
-    PHI->moveBefore(InsertPoint);
-    for (unsigned i = 0, e = PHI->getNumIncomingValues(); i != e; ++i) {
-      if (PHI->getIncomingBlock(i) == NextPH) {
-        PHI->setIncomingBlock(i, PrevPH);
-      } else if (PHI->getIncomingBlock(i) == NextLatch) {
-        PHI->setIncomingBlock(i, PrevLatch);
+  for (const FusionEdge &E : Edges) {
+    if (Part[E.From] == Part[E.To])
+      continue;
+    SmallSetVector<unsigned, 8> Group;
+    Group.insert(Part[E.From]);
+    Group.insert(Part[E.To]);
+    for (bool Changed = true; Changed;) {
+      Changed = false;
+      for (unsigned R = 0; R != N; ++R) {
+        if (Part[R] != R || Group.count(R))
+          continue;
+        bool FromGroup = any_of(Group, [&](unsigned G) { return reaches(G, R); });
+        bool ToGroup = any_of(Group, [&](unsigned G) { return reaches(R, G); });
+        if (FromGroup && ToGroup)
+          Changed |= Group.insert(R);
       }
     }
+
+    SmallVector<unsigned, 8> Members;
+    for (unsigned u = 0; u != N; ++u)
+      if (Group.count(Part[u]))
+        Members.push_back(u);
+    bool isLegal = all_of(Members, [&](unsigned u) {
+      return all_of(Members, [&](unsigned v) { return u >= v || Fusible[u][v]; });
+    });
+    if (!isLegal)
+      continue;
+    unsigned Leader = Part[Members.front()];
+    for (unsigned u : Members)
+      Part[u] = Leader;
   }
 
-  PrevHead->getTerminator()->replaceSuccessorWith(PrevExit, NextExit);
-  PrevBody->getTerminator()->replaceSuccessorWith(PrevLatch, NextBody);
-  NextBody->getTerminator()->replaceSuccessorWith(NextLatch, PrevLatch);
-  NextHead->getTerminator()->replaceSuccessorWith(NextBody, NextLatch);
-  if (PrevGuard)
-    PrevGuard->setSuccessor(1, NextExit);
+  // Ordine topologico delle partizioni: tra quelle pronte, quella con il loop
+  // che viene prima nella catena (Part[u] è il primo loop della partizione).
+  SmallVector<unsigned, 8> Order;
+  SmallVector<bool, 8> Placed(N, false);
+  while (Order.size() != N) {
+    for (unsigned P = 0; P != N; ++P) {
+      if (Part[P] != P || Placed[P])
+        continue;
+      bool isReady = true;
+      for (unsigned u = 0; u != N && isReady; ++u)
+        for (unsigned v = u + 1; v != N && isReady; ++v)
+          if (Dep[u][v] && Part[v] == P && Part[u] != P && !Placed[Part[u]])
+            isReady = false;
+      if (!isReady)
+        continue;
+      Placed[P] = true;
+      for (unsigned u = 0; u != N; ++u)
+        if (Part[u] == P)
+          Order.push_back(u);
+      break;
+    }
+  }
+  return Order;
+}
 
-  Lprev->addBasicBlockToLoop(NextBody, LI);
-  Lnext->removeBlockFromLoop(NextBody);
-  LI.erase(Lnext);
-  EliminateUnreachableBlocks(F);
+// Divide i loop fratelli (in ordine) in catene di regioni consecutive e, dove la
+// partizione lo chiede, scambia regioni adiacenti indipendenti per rendere
+// contigui i loop da fondere. Loops viene riordinato come le regioni.
+static bool reorderForFusion(MyLoopFusion &Pass, SmallVectorImpl<Loop *> &Loops, Function &F,
+                             FunctionAnalysisManager &FAM) {
+  LoopInfo &LI = FAM.getResult<LoopAnalysis>(F);
+  DominatorTree &DT = FAM.getResult<DominatorTreeAnalysis>(F);
+  ScalarEvolution &SE = FAM.getResult<ScalarEvolutionAnalysis>(F);
 
-  return Lprev;
+  bool Changed = false;
+  SmallVector<Loop *, 8> Reordered;
+  for (unsigned Start = 0, E = Loops.size(); Start != E;) {
+    unsigned End = Start + 1;
+    if (getLoopRegion(Loops[Start])) {
+      while (End != E && getLoopRegion(Loops[End]) &&
+             getLoopRegion(Loops[End - 1])->End == getLoopRegion(Loops[End])->Entry)
+        ++End;
+    }
+    SmallVector<Loop *, 8> Chain(Loops.begin() + Start, Loops.begin() + End);
+    Start = End;
+    // Con uno o due loop non c'è niente da riordinare: due regioni consecutive
+    // sono già adiacenti, e scambiarle non rende possibile nessuna fusione che
+    // il controllo a coppie in run non provi già. Si riordinano solo catene di
+    // almeno tre loop.
+    if (Chain.size() < 3) {
+      Reordered.append(Chain.begin(), Chain.end());
+      continue;
+    }
+
+    // Ogni loop viene portato al suo posto scambiandolo con quelli prima, che
+    // nell'ordine topologico vengono dopo e quindi non ne dipendono.
+    SmallVector<unsigned, 8> Order = partitionLoops(Pass, Chain, F, FAM);
+    SmallVector<Loop *, 8> Current(Chain.begin(), Chain.end());
+    for (unsigned Pos = 0; Pos != Order.size(); ++Pos) {
+      unsigned From = find(Current, Chain[Order[Pos]]) - Current.begin();
+      for (unsigned i = From; i != Pos; --i) {
+        Instruction *NextBegin =
+            i + 1 < Current.size() ? getLoopRegion(Current[i + 1])->Begin : nullptr;
+        swapRegions(Current[i - 1], Current[i], NextBegin, LI, DT, SE);
+        std::swap(Current[i - 1], Current[i]);
+        Changed = true;
+      }
+    }
+    Reordered.append(Current.begin(), Current.end());
+  }
+  Loops.assign(Reordered.begin(), Reordered.end());
+  return Changed;
+}
+
+// Codice tra due loop candidati: i blocchi in linea retta dall'uscita del
+// primo fino al guard (o al preheader) del secondo, più il preheader stesso. Non
+// contano le PHI, i salti, la condizione del guard e i valori che servono solo
+// al confronto di uscita del secondo loop, che spariscono con la fusione.
+// Restituisce false se tra i due loop c'è altro flusso di controllo.
+static bool collectInterveningCode(Loop *Lprev, Loop *Lnext,
+                                   SmallVectorImpl<BasicBlock *> &Blocks,
+                                   SmallVectorImpl<Instruction *> &Insts) {
+  BasicBlock *PrevExit = Lprev->getExitBlock();
+  BasicBlock *NextPH = Lnext->getLoopPreheader();
+  if (!PrevExit || !NextPH)
+    return false;
+  BranchInst *Guard = Lnext->getLoopGuardBranch();
+  BasicBlock *NextEntry = Guard ? Guard->getParent() : NextPH;
+  Instruction *GuardCond = Guard ? dyn_cast<Instruction>(Guard->getCondition()) : nullptr;
+  ICmpInst *NextCmp = getExitCmp(Lnext);
+
+  for (BasicBlock *BB = PrevExit; BB != NextEntry; BB = BB->getSingleSuccessor()) {
+    if (!BB || Blocks.size() == 8 || (BB != PrevExit && !BB->getSinglePredecessor()))
+      return false;
+    Blocks.push_back(BB);
+  }
+  Blocks.push_back(NextEntry);
+  if (NextEntry != NextPH)
+    Blocks.push_back(NextPH);
+
+  for (BasicBlock *BB : Blocks) {
+    for (Instruction &I : *BB) {
+      if (isa<PHINode>(I) || I.isTerminator() || &I == GuardCond)
+        continue;
+      if (!I.mayReadOrWriteMemory() && !I.use_empty() &&
+          all_of(I.users(), [&](User *U) { return U == NextCmp; }))
+        continue;
+      Insts.push_back(&I);
+    }
+  }
+  return true;
+}
+
+static bool hasInterveningCode(Loop *Lprev, Loop *Lnext) {
+  SmallVector<BasicBlock *, 4> Blocks;
+  SmallVector<Instruction *, 8> Insts;
+  return !collectInterveningCode(Lprev, Lnext, Blocks, Insts) || !Insts.empty();
+}
+
+// Dipendenza in memoria tra I e uno degli accessi di Other (un loop, o le
+// istruzioni che I scavalca). Le chiamate contano come dipendenti.
+static bool dependsOnAny(Instruction *I, ArrayRef<Instruction *> Others, DependenceInfo &DI) {
+  if (!I->mayReadOrWriteMemory())
+    return false;
+  for (Instruction *J : Others) {
+    if (!J->mayReadOrWriteMemory() || (!I->mayWriteToMemory() && !J->mayWriteToMemory()))
+      continue;
+    if ((!isa<LoadInst>(J) && !isa<StoreInst>(J)) || DI.depends(I, J, true))
+      return true;
+  }
+  return false;
+}
+
+// Spostamento del codice tra due loop: lo decide planInterveningCodeMotion,
+// senza toccare l'IR, e lo fa moveInterveningCode solo se i loop vengono fusi.
+namespace {
+struct InterveningCodeMotion {
+  // dall'uscita del primo loop al preheader del secondo
+  SmallVector<BasicBlock *, 4> Blocks;
+  // portate prima della regione del primo loop, nell'ordine in cui erano
+  SmallVector<Instruction *, 8> Hoisted;
+  // portate dopo la regione del secondo loop, nell'ordine in cui erano
+  SmallVector<Instruction *, 8> Sunk;
+  Instruction *HoistPt = nullptr;
+  BasicBlock *SinkBB = nullptr;
+};
+} // namespace
+
+// Decide come spostare il codice tra Lprev e Lnext prima della regione del primo
+// loop o dopo quella del secondo, dove viene eseguito lo stesso numero di volte.
+// In avanti si sceglie cosa portare prima: gli operandi devono essere già
+// disponibili e non ci devono essere dipendenze con quello che il codice
+// scavalca (la fine del blocco di ingresso della regione, il preheader, il primo
+// loop e la sua uscita) né con il codice che resta dopo. All'indietro il resto va
+// dopo il secondo loop: nessun uso nel secondo loop o nel codice che resta e
+// nessuna dipendenza con il preheader, il secondo loop e la sua uscita.
+// Il preheader di un secondo loop con guard e l'uscita di un primo loop con guard
+// vengono eseguiti solo insieme al loop: il loro codice si sposta solo se si può
+// eseguire sempre (niente store, load solo da memoria sicuramente valida).
+// Restituisce false se non tutto il codice si può spostare o se, unendo poi i
+// blocchi rimasti vuoti all'uscita del primo loop, i loop non diventano adiacenti.
+static bool planInterveningCodeMotion(Loop *Lprev, Loop *Lnext, Function &F,
+                                      FunctionAnalysisManager &FAM,
+                                      InterveningCodeMotion &Motion) {
+  DependenceInfo &DI = FAM.getResult<DependenceAnalysis>(F);
+  DominatorTree &DT = FAM.getResult<DominatorTreeAnalysis>(F);
+
+  SmallVector<Instruction *, 8> Insts;
+  if (!collectInterveningCode(Lprev, Lnext, Motion.Blocks, Insts) || Insts.empty())
+    return false;
+  std::optional<LoopRegion> PrevRegion = getLoopRegion(Lprev);
+  std::optional<LoopRegion> NextRegion = getLoopRegion(Lnext);
+  if (!PrevRegion || !NextRegion)
+    return false;
+  Motion.HoistPt = PrevRegion->Begin;
+  Motion.SinkBB = NextRegion->End;
+
+  // l'uscita del primo loop, con i blocchi uniti, prosegue nel guard del secondo
+  BasicBlock *PrevExit = Motion.Blocks.front();
+  BasicBlock *NextPH = Lnext->getLoopPreheader();
+  BranchInst *NextGuard = Lnext->getLoopGuardBranch();
+  BasicBlock *NextEntry = NextGuard ? NextGuard->getParent() : NextPH;
+  if (PrevExit != NextPH && (!NextGuard || PrevExit == NextEntry))
+    return false;
+
+  bool isPrevGuarded = Lprev->getLoopGuardBranch();
+  auto isMovable = [&](Instruction *I) {
+    if ((I->getParent() == NextPH && NextPH != NextEntry) ||
+        (I->getParent() == PrevExit && isPrevGuarded))
+      return isSafeToSpeculativelyExecute(I);
+    if (I->mayReadOrWriteMemory())
+      return isa<LoadInst>(I) ? cast<LoadInst>(I)->isSimple()
+             : isa<StoreInst>(I) ? cast<StoreInst>(I)->isSimple()
+                                 : false;
+    return !I->mayHaveSideEffects() && !isa<AllocaInst>(I);
+  };
+
+  SmallPtrSet<Instruction *, 8> InstSet(Insts.begin(), Insts.end());
+  SmallVector<Instruction *, 16> PrevAccesses, NextAccesses;
+  auto addBlock = [&](BasicBlock *BB, SmallVectorImpl<Instruction *> &Accesses) {
+    for (Instruction &I : *BB)
+      if (!InstSet.count(&I))
+        Accesses.push_back(&I);
+  };
+  for (Instruction *I = Motion.HoistPt; I; I = I->getNextNode())
+    PrevAccesses.push_back(I);
+  if (Lprev->getLoopPreheader() != PrevRegion->Entry)
+    addBlock(Lprev->getLoopPreheader(), PrevAccesses);
+  for (BasicBlock *BB : Lprev->blocks())
+    addBlock(BB, PrevAccesses);
+  addBlock(PrevExit, PrevAccesses);
+  addBlock(NextPH, NextAccesses);
+  for (BasicBlock *BB : Lnext->blocks())
+    addBlock(BB, NextAccesses);
+  if (Lnext->getExitBlock() != Motion.SinkBB)
+    addBlock(Lnext->getExitBlock(), NextAccesses);
+
+  SmallPtrSet<Instruction *, 8> Sunk;
+  SmallVector<Instruction *, 8> Staying;
+  for (Instruction *I : Insts) {
+    bool isHoistable =
+        isMovable(I) && all_of(I->operands(), [&](Value *Op) {
+          auto *OpI = dyn_cast<Instruction>(Op);
+          return !OpI || is_contained(Motion.Hoisted, OpI) ||
+                 DT.dominates(OpI, Motion.HoistPt);
+        }) &&
+        !dependsOnAny(I, PrevAccesses, DI) && !dependsOnAny(I, Staying, DI);
+    if (isHoistable)
+      Motion.Hoisted.push_back(I);
+    else
+      Staying.push_back(I);
+  }
+  for (Instruction *I : reverse(Staying)) {
+    bool isSinkable =
+        isMovable(I) && all_of(I->users(), [&](User *U) {
+          auto *UI = cast<Instruction>(U);
+          return Sunk.count(UI) || (!isa<PHINode>(UI) && !Lnext->contains(UI) &&
+                                    !is_contained(Motion.Blocks, UI->getParent()) &&
+                                    DT.dominates(Motion.SinkBB, UI->getParent()));
+        }) &&
+        !dependsOnAny(I, NextAccesses, DI);
+    if (!isSinkable)
+      return false;
+    Sunk.insert(I);
+  }
+  Motion.Sunk = std::move(Staying);
+  return true;
+}
+
+// Fa lo spostamento deciso da planInterveningCodeMotion: i blocchi tra
+// l'uscita del primo loop e il secondo restano vuoti e vengono uniti.
+static void moveInterveningCode(Loop *Lnext, const InterveningCodeMotion &Motion,
+                                LoopInfo &LI, DominatorTree &DT) {
+  for (Instruction *I : Motion.Hoisted)
+    I->moveBefore(Motion.HoistPt);
+  for (Instruction *I : reverse(Motion.Sunk))
+    I->moveBefore(&*Motion.SinkBB->getFirstInsertionPt());
+  NumMovedAround += Motion.Hoisted.size() + Motion.Sunk.size();
+
+  BasicBlock *NextPH = Lnext->getLoopPreheader();
+  BranchInst *Guard = Lnext->getLoopGuardBranch();
+  BasicBlock *NextEntry = Guard ? Guard->getParent() : NextPH;
+  DomTreeUpdater DTU(DT, DomTreeUpdater::UpdateStrategy::Eager);
+  for (BasicBlock *BB : drop_begin(Motion.Blocks))
+    if (BB != NextEntry && BB != NextPH)
+      MergeBlockIntoPredecessor(BB, &DTU, &LI);
 }
 
 PreservedAnalyses MyLoopFusion::run(Function &F, FunctionAnalysisManager &FAM) {
+  TimeTraceScope TimeScope("MyLoopFusion", F.getName());
   LoopInfo &LI = FAM.getResult<LoopAnalysis>(F);
+  DominatorTree &DT = FAM.getResult<DominatorTreeAnalysis>(F);
+  OptimizationRemarkEmitter &ORE = FAM.getResult<OptimizationRemarkEmitterAnalysis>(F);
 
-  // Itera i loop in ordine di apparizione nel function, tenendo il "precedente"
-  // per poter fondere finché possibile.
-  // Ordina i loop in base all'ordine dei blocchi nella function.
-  DenseMap<BasicBlock *, unsigned> BBOrder;
-  unsigned Index = 0;
-  for (BasicBlock &BB : F)
-    BBOrder[&BB] = Index++;
-
-  SmallVector<Loop *, 8> Loops;
-  for (Loop *L : LI)
-    Loops.push_back(L);
-
-  auto OrderKey = [&](Loop *L) -> unsigned {
-    if (BasicBlock *H = L->getLoopPreheader())
-      return BBOrder.lookup(H);
-    return BBOrder.lookup(L->getHeader());
+  // Il remark va emesso prima del merge, che cancella il secondo loop
+  auto emitFused = [&](Loop *L) {
+    ++NumFused;
+    ORE.emit([&]() {
+      return OptimizationRemark(DEBUG_TYPE, "Fused", L->getStartLoc(), L->getHeader())
+             << "loop fused with the preceding loop";
+    });
   };
-  llvm::sort(Loops, [&](Loop *A, Loop *B) { return OrderKey(A) < OrderKey(B); });
 
-  Loop *Lprev = nullptr;
+  // Fonde una lista di loop fratelli, in ordine di apparizione nella function,
+  // tenendo il "precedente" per poter fondere finché possibile. Restituisce i
+  // loop rimasti dopo le fusioni.
   bool hasBeenOptimized = false;
-  for (Loop *L : Loops) {
-
-    if (Lprev) {
-      
-      if (areLoopsAdjacent(Lprev, L) &&
-          Lprev->getHeader() == Lprev->getLoopLatch() &&
-          L->getHeader() == L->getLoopLatch() &&
-          areLoopsIndependent(Lprev, L, F, FAM)) {
-        hasBeenOptimized = true;
-        Lprev = merge(Lprev, L, F, FAM);
-      } else if (areLoopsAdjacent(Lprev, L) && areLoopsTCE(Lprev, L, F, FAM) &&
-                 areLoopsCFE(Lprev, L, F, FAM) &&
-                 areLoopsIndependent(Lprev, L, F, FAM)) {
-        hasBeenOptimized = true;
-        Lprev = merge(Lprev, L, F, FAM);
+  auto fuseSiblings = [&](SmallVector<Loop *, 8> Loops) {
+    // Ordina i loop in base all'ordine dei blocchi nella function (ricalcolato:
+    // il peeling e le fusioni precedenti aggiungono e tolgono blocchi).
+    DenseMap<BasicBlock *, unsigned> BBOrder;
+    unsigned Index = 0;
+    for (BasicBlock &BB : F)
+      BBOrder[&BB] = Index++;
+
+    auto OrderKey = [&](Loop *L) -> unsigned {
+      if (BasicBlock *H = L->getLoopPreheader())
+        return BBOrder.lookup(H);
+      return BBOrder.lookup(L->getHeader());
+    };
+    llvm::sort(Loops, [&](Loop *A, Loop *B) { return OrderKey(A) < OrderKey(B); });
+    hasBeenOptimized |= reorderForFusion(*this, Loops, F, FAM);
+
+    SmallVector<Loop *, 8> Fused;
+    Loop *Lprev = nullptr;
+    for (Loop *L : Loops) {
+
+      if (Lprev) {
+        
+        // Anche i loop a blocco singolo devono avere lo stesso trip count, dopo
+        // l'eventuale peeling: il loop fuso esce con la condizione del primo.
+        bool areSingleBlock = Lprev->getHeader() == Lprev->getLoopLatch() &&
+                              L->getHeader() == L->getLoopLatch();
+        // Il codice tra i due loop si sposta solo se poi vengono fusi: i controlli
+        // lo considerano già spostato (i valori portati prima del primo loop sono
+        // disponibili, i blocchi in mezzo sono uniti all'uscita del primo).
+        InterveningCodeMotion Motion;
+        bool isAdjacent = areLoopsAdjacent(Lprev, L) && !hasInterveningCode(Lprev, L);
+        bool needsMotion = !isAdjacent && EnableCodeMotion && areLoopsTCE(Lprev, L, F, FAM) &&
+                           areLoopsIndependent(Lprev, L, F, FAM) &&
+                           planInterveningCodeMotion(Lprev, L, F, FAM, Motion);
+        isAdjacent = (isAdjacent || needsMotion) &&
+                     usesOnlyValuesBefore(Lprev, L, DT, Motion.Hoisted);
+
+        bool isLegal = isAdjacent && areLoopsTCE(Lprev, L, F, FAM) &&
+                       (areSingleBlock || areLoopsCFE(Lprev, L, F, FAM)) &&
+                       haveEquivalentGuards(Lprev, L, Motion.Blocks) &&
+                       haveMergeableForms(Lprev, L) && areLoopsIndependent(Lprev, L, F, FAM);
+        bool isFused = false;
+        if (isLegal && isFusionProfitable(Lprev, L, F, FAM)) {
+          hasBeenOptimized = true;
+          if (needsMotion) {
+            moveInterveningCode(L, Motion, LI, DT);
+            assert(areLoopsAdjacent(Lprev, L) && !hasInterveningCode(Lprev, L) &&
+                   "Loops not adjacent after moving the code between them");
+          }
+          // Il peeling in testa ricrea preheader e uscita del primo loop, e le
+          // iterazioni tolte arrivano al guard del secondo: adiacenza e guard
+          // vanno ricontrollati. Se non valgono più il peeling resta, la
+          // fusione no. Il peeling in coda non tocca il percorso tra i due loop.
+          isFused = !alignTripCounts(Lprev, L, F, FAM) ||
+                    (areLoopsAdjacent(Lprev, L) && !hasInterveningCode(Lprev, L) &&
+                     haveEquivalentGuards(Lprev, L));
+          isAdjacent = isLegal = isFused;
+        }
+        if (isFused) {
+          emitFused(L);
+          Lprev = merge(Lprev, L, F, FAM);
+          if (EnableContraction)
+            contractArrays(Lprev, F, FAM);
+        } else {
+          ++NumNotFused;
+          if (isLegal)
+            ++NumUnprofitable;
+          // Il motivo viene ricalcolato solo se i remark sono abilitati
+          ORE.emit([&]() {
+            StringRef Reason =
+                !isAdjacent                                                         ? "NotAdjacent"
+                : !areLoopsIndependent(Lprev, L, F, FAM)                            ? "Dependent"
+                : !areLoopsTCE(Lprev, L, F, FAM)                                    ? "TripCountMismatch"
+                : !haveMergeableForms(Lprev, L)                                     ? "UnsupportedLoopForm"
+                : !isLegal                                                          ? "NotControlFlowEquivalent"
+                                                                                    : "NotProfitable";
+            return OptimizationRemarkMissed(DEBUG_TYPE, Reason, L->getStartLoc(), L->getHeader())
+                   << "loop not fused with the preceding loop";
+          });
+          Fused.push_back(Lprev);
+          Lprev = L;
+        }
       } else {
         Lprev = L;
       }
-    } else {
-      Lprev = L;
     }
+    if (Lprev)
+      Fused.push_back(Lprev);
+    return Fused;
+  };
+
+  // Si parte dai loop esterni e si scende: dopo la fusione di due nidi i loop
+  // interni diventano fratelli nel loop fuso, e vengono fusi al livello dopo.
+  SmallVector<SmallVector<Loop *, 8>, 4> Worklist;
+  Worklist.emplace_back(LI.begin(), LI.end());
+  while (!Worklist.empty()) {
+    SmallVector<Loop *, 8> Siblings = Worklist.pop_back_val();
+    for (Loop *L : fuseSiblings(std::move(Siblings)))
+      if (!L->isInnermost())
+        Worklist.emplace_back(L->begin(), L->end());
   }
 
-  return hasBeenOptimized ? PreservedAnalyses::none()
-                          : PreservedAnalyses::all();
+  if (!hasBeenOptimized)
+    return PreservedAnalyses::all();
+  // merge, il peeling e gli spostamenti tengono aggiornate queste analisi
+  PreservedAnalyses PA;
+  PA.preserve<DominatorTreeAnalysis>();
+  PA.preserve<LoopAnalysis>();
+  PA.preserve<ScalarEvolutionAnalysis>();
+  return PA;
 }
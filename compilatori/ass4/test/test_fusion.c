@@ -1,4 +1,112 @@
-void f(int *a, int *b, int n) {
+void f(int *restrict a, int *restrict b, int n) {
   for (int i=0; i<n; i++) a[i] = a[i] + 1;
   for (int i=0; i<n; i++) b[i] = b[i] + 2;
 }
+
+// Il primo loop ha un'iterazione in più: la prima viene tolta con il peeling
+void g(int *restrict a, int *restrict b, int n) {
+  for (int i=0; i<n; i++) a[i] = a[i] + 1;
+  for (int i=1; i<n; i++) b[i] = b[i] + 2;
+}
+
+// Il secondo loop ha un'iterazione in più, tolta in coda; la sua IV parte da 0
+// e viene riscritta in funzione di quella del primo, che parte da 1
+void h(int *restrict a, int *restrict b, int n) {
+  for (int i=1; i<n; i++) a[i] = a[i] + 1;
+  for (int i=0; i<n; i++) b[i] = b[i] + 2;
+}
+
+// Il secondo loop legge a[i+1], che il primo scrive all'iterazione successiva:
+// nel loop fuso leggerebbe il valore vecchio, quindi non vengono fusi
+void k(int *restrict a, int *restrict b, int n) {
+  for (int i=0; i<n; i++) a[i] = a[i] + 1;
+  for (int i=0; i<n; i++) b[i] = a[i+1];
+}
+
+// a[i] e a[i-1] vengono scritti dal primo loop nella stessa iterazione del loop
+// fuso o in quella prima, contando l'iterazione tolta in testa con il peeling
+void m(int *restrict a, int *restrict b, int n) {
+  for (int i=0; i<n; i++) a[i] = a[i] + 1;
+  for (int i=1; i<n; i++) b[i] = a[i] + a[i-1];
+}
+
+#define W 64
+
+// Due nidi sulle stesse righe e colonne: vengono fusi i loop esterni e poi, nel
+// loop fuso, quelli interni
+void p(int (*restrict a)[W], int (*restrict b)[W], int h) {
+  for (int y=0; y<h; y++)
+    for (int x=0; x<W; x++) a[y][x] = a[y][x] + 1;
+  for (int y=0; y<h; y++)
+    for (int x=0; x<W; x++) b[y][x] = a[y][x] * 2;
+}
+
+// Il loop su c non si può fondere con gli altri (trip count diverso) ma non
+// dipende da loro: viene spostato dopo, così il primo e il terzo loop diventano
+// adiacenti e vengono fusi
+void q(int *restrict a, int *restrict b, int *restrict c, int n, int m) {
+  for (int i=0; i<n; i++) a[i] = a[i] + 1;
+  for (int i=0; i<m; i++) c[i] = c[i] * 3;
+  for (int i=0; i<n; i++) b[i] = a[i] * 2;
+}
+
+#define N 1024
+
+// Dopo la fusione t[i] viene scritto e letto nella stessa iterazione e non
+// serve più: l'array viene sostituito dal valore calcolato e l'alloca tolta
+void r(int *restrict a, int *restrict b, int n) {
+  int t[N];
+  for (int i=0; i<n; i++) t[i] = a[i] * 2;
+  for (int i=0; i<n; i++) b[i] = t[i] + 1;
+}
+
+// Il codice tra i due loop non blocca la fusione: k non dipende dal primo loop
+// e viene calcolato prima di esso, la copia di a[0] dipende dal primo loop ma
+// non dal secondo e viene spostata dopo
+void s(int *restrict a, int *restrict b, int *restrict c, int n) {
+  for (int i=0; i<n; i++) a[i] = a[i] + 1;
+  int k = c[0] * 3;
+  c[1] = a[0];
+  for (int i=0; i<n; i++) b[i] = a[i] + k;
+}
+
+// Loop con un if nel corpo: i corpi vengono uniti così come sono, il secondo
+// dopo il primo in ogni iterazione
+void t(int *restrict a, int *restrict b, int n) {
+  for (int i=0; i<n; i++)
+    if (a[i] > 0) a[i] = a[i] - 1;
+  for (int i=0; i<n; i++)
+    if (a[i] > 0) b[i] = a[i]; else b[i] = 0;
+}
+
+// Come t, ma in test_fusion.ll i loop sono in forma for (non ruotati, come
+// prima di loop-rotate): il test di uscita è nell'header
+void u(int *restrict a, int *restrict b, int n) {
+  for (int i=0; i<n; i++)
+    if (a[i] > 0) a[i] = a[i] - 1;
+  for (int i=0; i<n; i++)
+    if (a[i] > 0) b[i] = a[i]; else b[i] = 0;
+}
+
+// Il secondo loop si ferma un'iterazione prima: i bound n e n-1 vengono estesi
+// a 64 bit separatamente, la differenza tra i trip count si calcola prima
+// dell'estensione. L'iterazione in più del primo loop viene tolta in testa
+void v(int *restrict a, int *restrict b, int n) {
+  for (int i=0; i<n; i++) a[i] = a[i] + 1;
+  for (int i=0; i<n-1; i++) b[i] = b[i] + 2;
+}
+
+// Valore iniziale e bound diversi in entrambi i loop: il primo fa n-3
+// iterazioni, il secondo n-1, le due in più del secondo vengono tolte in coda
+void w(int *restrict a, int *restrict b, int n) {
+  for (int i=0; i<n-3; i++) a[i] = a[i] + 1;
+  for (int i=1; i<n; i++) b[i] = b[i] + 2;
+}
+
+// Tre loop di fila con lo stesso guard: dopo ogni fusione il guard del loop
+// fuso è ridondante e viene tolto, il loop fuso resta adiacente al successivo
+void x(int *restrict a, int *restrict b, int *restrict c, int *restrict d, int n) {
+  for (int i=0; i<n; i++) b[i] = a[i] + 1;
+  for (int i=0; i<n; i++) c[i] = b[i] + 1;
+  for (int i=0; i<n; i++) d[i] = c[i] + 1;
+}
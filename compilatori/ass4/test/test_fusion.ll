@@ -1,10 +1,39 @@
+; RUN: opt -passes='loop-simplify,MyLoopFusion' -pass-remarks-output=%t.yaml -disable-output %s
+; RUN: FileCheck --check-prefix=REMARK %s < %t.yaml
+; REMARK:      --- !Passed
+; REMARK-NEXT: Pass:            myloopfusion
+; REMARK-NEXT: Name:            Fused
+; REMARK-NEXT: Function:        f
+; REMARK:      Name:            Fused
+; REMARK-NEXT: Function:        g
+;
+; In g la prima iterazione del primo loop viene tolta in testa con il peeling,
+; poi i due loop diventano uno solo che scrive a e b con la stessa IV
+; RUN: opt -passes='loop-simplify,MyLoopFusion' -S %s | FileCheck --check-prefix=PEEL %s
+; PEEL-LABEL: define void @g(
+; PEEL:       .peel.begin:
+; PEEL:       [[IV:%.*]] = phi i64
+; PEEL:       getelementptr inbounds i32, ptr %0, i64 [[IV]]
+; PEEL:       getelementptr inbounds i32, ptr %1, i64 [[IV]]
+; PEEL:       !llvm.loop
+; PEEL-NOT:   !llvm.loop
+; PEEL-LABEL: define void @h(
+;
+; In h il resto del secondo loop riparte dal valore con cui esce il loop fuso:
+; con l'input in forma LCSSA il valore passa da una PHI nell'uscita del loop
+; RUN: opt -passes='loop-simplify,lcssa,MyLoopFusion' -S %s | FileCheck --check-prefix=LCSSA %s
+; LCSSA-LABEL: define void @h(
+; LCSSA:       [[LAST:%.*]] = phi i64 [ %{{[0-9]+}}, %{{[0-9]+}} ]
+; LCSSA:       .peel.start{{[0-9]*}} = phi i64 [ [[LAST]], %{{.*}} ], [ 0, %{{[0-9]+}} ]
+; LCSSA-LABEL: define void @k(
+
 ; ModuleID = 'test_fusion.c'
 source_filename = "test_fusion.c"
 target datalayout = "e-m:o-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
 target triple = "x86_64-apple-macosx15.0.0"
 
 ; Function Attrs: nofree norecurse nosync nounwind ssp memory(argmem: readwrite) uwtable
-define void @f(ptr nocapture noundef %0, ptr nocapture noundef %1, i32 noundef %2) local_unnamed_addr #0 {
+define void @f(ptr noalias nocapture noundef %0, ptr noalias nocapture noundef %1, i32 noundef %2) local_unnamed_addr #0 {
   %4 = icmp sgt i32 %2, 0
   br i1 %4, label %5, label %7
 
@@ -44,7 +73,658 @@ define void @f(ptr nocapture noundef %0, ptr nocapture noundef %1, i32 noundef %
   br i1 %25, label %18, label %19, !llvm.loop !12
 }
 
+; Function Attrs: nofree norecurse nosync nounwind ssp memory(argmem: readwrite) uwtable
+define void @g(ptr noalias nocapture noundef %0, ptr noalias nocapture noundef %1, i32 noundef %2) local_unnamed_addr #0 {
+  %4 = icmp sgt i32 %2, 0
+  br i1 %4, label %5, label %7
+
+5:                                                ; preds = %3
+  %6 = zext i32 %2 to i64
+  br label %11
+
+7:                                                ; preds = %11, %3
+  %8 = icmp sgt i32 %2, 1
+  br i1 %8, label %9, label %18
+
+9:                                                ; preds = %7
+  %10 = zext i32 %2 to i64
+  br label %19
+
+11:                                               ; preds = %5, %11
+  %12 = phi i64 [ 0, %5 ], [ %16, %11 ]
+  %13 = getelementptr inbounds i32, ptr %0, i64 %12
+  %14 = load i32, ptr %13, align 4, !tbaa !5
+  %15 = add nsw i32 %14, 1
+  store i32 %15, ptr %13, align 4, !tbaa !5
+  %16 = add nuw nsw i64 %12, 1
+  %17 = icmp eq i64 %16, %6
+  br i1 %17, label %7, label %11, !llvm.loop !13
+
+18:                                               ; preds = %19, %7
+  ret void
+
+19:                                               ; preds = %9, %19
+  %20 = phi i64 [ 1, %9 ], [ %24, %19 ]
+  %21 = getelementptr inbounds i32, ptr %1, i64 %20
+  %22 = load i32, ptr %21, align 4, !tbaa !5
+  %23 = add nsw i32 %22, 2
+  store i32 %23, ptr %21, align 4, !tbaa !5
+  %24 = add nuw nsw i64 %20, 1
+  %25 = icmp eq i64 %24, %10
+  br i1 %25, label %18, label %19, !llvm.loop !14
+}
+
+; Function Attrs: nofree norecurse nosync nounwind ssp memory(argmem: readwrite) uwtable
+define void @h(ptr noalias nocapture noundef %0, ptr noalias nocapture noundef %1, i32 noundef %2) local_unnamed_addr #0 {
+  %4 = icmp sgt i32 %2, 1
+  br i1 %4, label %5, label %7
+
+5:                                                ; preds = %3
+  %6 = zext i32 %2 to i64
+  br label %11
+
+7:                                                ; preds = %11, %3
+  %8 = icmp sgt i32 %2, 0
+  br i1 %8, label %9, label %18
+
+9:                                                ; preds = %7
+  %10 = zext i32 %2 to i64
+  br label %19
+
+11:                                               ; preds = %5, %11
+  %12 = phi i64 [ 1, %5 ], [ %16, %11 ]
+  %13 = getelementptr inbounds i32, ptr %0, i64 %12
+  %14 = load i32, ptr %13, align 4, !tbaa !5
+  %15 = add nsw i32 %14, 1
+  store i32 %15, ptr %13, align 4, !tbaa !5
+  %16 = add nuw nsw i64 %12, 1
+  %17 = icmp eq i64 %16, %6
+  br i1 %17, label %7, label %11, !llvm.loop !15
+
+18:                                               ; preds = %19, %7
+  ret void
+
+19:                                               ; preds = %9, %19
+  %20 = phi i64 [ 0, %9 ], [ %24, %19 ]
+  %21 = getelementptr inbounds i32, ptr %1, i64 %20
+  %22 = load i32, ptr %21, align 4, !tbaa !5
+  %23 = add nsw i32 %22, 2
+  store i32 %23, ptr %21, align 4, !tbaa !5
+  %24 = add nuw nsw i64 %20, 1
+  %25 = icmp eq i64 %24, %10
+  br i1 %25, label %18, label %19, !llvm.loop !16
+}
+
+; Function Attrs: nofree norecurse nosync nounwind ssp memory(argmem: readwrite) uwtable
+define void @k(ptr noalias nocapture noundef %0, ptr noalias nocapture noundef %1, i32 noundef %2) local_unnamed_addr #0 {
+  %4 = icmp sgt i32 %2, 0
+  br i1 %4, label %5, label %7
+
+5:                                                ; preds = %3
+  %6 = zext i32 %2 to i64
+  br label %11
+
+7:                                                ; preds = %11, %3
+  %8 = icmp sgt i32 %2, 0
+  br i1 %8, label %9, label %18
+
+9:                                                ; preds = %7
+  %10 = zext i32 %2 to i64
+  br label %19
+
+11:                                               ; preds = %5, %11
+  %12 = phi i64 [ 0, %5 ], [ %16, %11 ]
+  %13 = getelementptr inbounds i32, ptr %0, i64 %12
+  %14 = load i32, ptr %13, align 4, !tbaa !5
+  %15 = add nsw i32 %14, 1
+  store i32 %15, ptr %13, align 4, !tbaa !5
+  %16 = add nuw nsw i64 %12, 1
+  %17 = icmp eq i64 %16, %6
+  br i1 %17, label %7, label %11, !llvm.loop !17
+
+18:                                               ; preds = %19, %7
+  ret void
+
+19:                                               ; preds = %9, %19
+  %20 = phi i64 [ 0, %9 ], [ %21, %19 ]
+  %21 = add nuw nsw i64 %20, 1
+  %22 = getelementptr inbounds i32, ptr %0, i64 %21
+  %23 = load i32, ptr %22, align 4, !tbaa !5
+  %24 = getelementptr inbounds i32, ptr %1, i64 %20
+  store i32 %23, ptr %24, align 4, !tbaa !5
+  %25 = icmp eq i64 %21, %10
+  br i1 %25, label %18, label %19, !llvm.loop !18
+}
+
+; Function Attrs: nofree norecurse nosync nounwind ssp memory(argmem: readwrite) uwtable
+define void @m(ptr noalias nocapture noundef %0, ptr noalias nocapture noundef %1, i32 noundef %2) local_unnamed_addr #0 {
+  %4 = icmp sgt i32 %2, 0
+  br i1 %4, label %5, label %7
+
+5:                                                ; preds = %3
+  %6 = zext i32 %2 to i64
+  br label %11
+
+7:                                                ; preds = %11, %3
+  %8 = icmp sgt i32 %2, 1
+  br i1 %8, label %9, label %18
+
+9:                                                ; preds = %7
+  %10 = zext i32 %2 to i64
+  br label %19
+
+11:                                               ; preds = %5, %11
+  %12 = phi i64 [ 0, %5 ], [ %16, %11 ]
+  %13 = getelementptr inbounds i32, ptr %0, i64 %12
+  %14 = load i32, ptr %13, align 4, !tbaa !5
+  %15 = add nsw i32 %14, 1
+  store i32 %15, ptr %13, align 4, !tbaa !5
+  %16 = add nuw nsw i64 %12, 1
+  %17 = icmp eq i64 %16, %6
+  br i1 %17, label %7, label %11, !llvm.loop !19
+
+18:                                               ; preds = %19, %7
+  ret void
+
+19:                                               ; preds = %9, %19
+  %20 = phi i64 [ 1, %9 ], [ %28, %19 ]
+  %21 = getelementptr inbounds i32, ptr %0, i64 %20
+  %22 = load i32, ptr %21, align 4, !tbaa !5
+  %23 = add nsw i64 %20, -1
+  %24 = getelementptr inbounds i32, ptr %0, i64 %23
+  %25 = load i32, ptr %24, align 4, !tbaa !5
+  %26 = add nsw i32 %25, %22
+  %27 = getelementptr inbounds i32, ptr %1, i64 %20
+  store i32 %26, ptr %27, align 4, !tbaa !5
+  %28 = add nuw nsw i64 %20, 1
+  %29 = icmp eq i64 %28, %10
+  br i1 %29, label %18, label %19, !llvm.loop !20
+}
+
+; Function Attrs: nofree norecurse nosync nounwind ssp memory(argmem: readwrite) uwtable
+define void @p(ptr noalias nocapture noundef %0, ptr noalias nocapture noundef %1, i32 noundef %2) local_unnamed_addr #0 {
+  %4 = icmp sgt i32 %2, 0
+  br i1 %4, label %5, label %7
+
+5:                                                ; preds = %3
+  %6 = zext i32 %2 to i64
+  br label %11
+
+7:                                                ; preds = %14, %3
+  %8 = icmp sgt i32 %2, 0
+  br i1 %8, label %9, label %13
+
+9:                                                ; preds = %7
+  %10 = zext i32 %2 to i64
+  br label %24
+
+11:                                               ; preds = %14, %5
+  %12 = phi i64 [ 0, %5 ], [ %15, %14 ]
+  br label %17
+
+13:                                               ; preds = %26, %7
+  ret void
+
+14:                                               ; preds = %17
+  %15 = add nuw nsw i64 %12, 1
+  %16 = icmp eq i64 %15, %6
+  br i1 %16, label %7, label %11, !llvm.loop !21
+
+17:                                               ; preds = %17, %11
+  %18 = phi i64 [ 0, %11 ], [ %22, %17 ]
+  %19 = getelementptr inbounds [64 x i32], ptr %0, i64 %12, i64 %18
+  %20 = load i32, ptr %19, align 4, !tbaa !5
+  %21 = add nsw i32 %20, 1
+  store i32 %21, ptr %19, align 4, !tbaa !5
+  %22 = add nuw nsw i64 %18, 1
+  %23 = icmp eq i64 %22, 64
+  br i1 %23, label %14, label %17, !llvm.loop !22
+
+24:                                               ; preds = %26, %9
+  %25 = phi i64 [ 0, %9 ], [ %27, %26 ]
+  br label %29
+
+26:                                               ; preds = %29
+  %27 = add nuw nsw i64 %25, 1
+  %28 = icmp eq i64 %27, %10
+  br i1 %28, label %13, label %24, !llvm.loop !23
+
+29:                                               ; preds = %29, %24
+  %30 = phi i64 [ 0, %24 ], [ %35, %29 ]
+  %31 = getelementptr inbounds [64 x i32], ptr %0, i64 %25, i64 %30
+  %32 = load i32, ptr %31, align 4, !tbaa !5
+  %33 = shl nsw i32 %32, 1
+  %34 = getelementptr inbounds [64 x i32], ptr %1, i64 %25, i64 %30
+  store i32 %33, ptr %34, align 4, !tbaa !5
+  %35 = add nuw nsw i64 %30, 1
+  %36 = icmp eq i64 %35, 64
+  br i1 %36, label %26, label %29, !llvm.loop !24
+}
+
+; Function Attrs: nofree norecurse nosync nounwind ssp memory(argmem: readwrite) uwtable
+define void @q(ptr noalias nocapture noundef %0, ptr noalias nocapture noundef %1, ptr noalias nocapture noundef %2, i32 noundef %3, i32 noundef %4) local_unnamed_addr #0 {
+  %6 = icmp sgt i32 %3, 0
+  br i1 %6, label %7, label %9
+
+7:                                                ; preds = %5
+  %8 = zext i32 %3 to i64
+  br label %18
+
+9:                                                ; preds = %18, %5
+  %10 = icmp sgt i32 %4, 0
+  br i1 %10, label %11, label %13
+
+11:                                               ; preds = %9
+  %12 = zext i32 %4 to i64
+  br label %25
+
+13:                                               ; preds = %25, %9
+  %14 = icmp sgt i32 %3, 0
+  br i1 %14, label %15, label %17
+
+15:                                               ; preds = %13
+  %16 = zext i32 %3 to i64
+  br label %32
+
+17:                                               ; preds = %32, %13
+  ret void
+
+18:                                               ; preds = %18, %7
+  %19 = phi i64 [ 0, %7 ], [ %23, %18 ]
+  %20 = getelementptr inbounds i32, ptr %0, i64 %19
+  %21 = load i32, ptr %20, align 4, !tbaa !5
+  %22 = add nsw i32 %21, 1
+  store i32 %22, ptr %20, align 4, !tbaa !5
+  %23 = add nuw nsw i64 %19, 1
+  %24 = icmp eq i64 %23, %8
+  br i1 %24, label %9, label %18, !llvm.loop !25
+
+25:                                               ; preds = %25, %11
+  %26 = phi i64 [ 0, %11 ], [ %30, %25 ]
+  %27 = getelementptr inbounds i32, ptr %2, i64 %26
+  %28 = load i32, ptr %27, align 4, !tbaa !5
+  %29 = mul nsw i32 %28, 3
+  store i32 %29, ptr %27, align 4, !tbaa !5
+  %30 = add nuw nsw i64 %26, 1
+  %31 = icmp eq i64 %30, %12
+  br i1 %31, label %13, label %25, !llvm.loop !26
+
+32:                                               ; preds = %32, %15
+  %33 = phi i64 [ 0, %15 ], [ %38, %32 ]
+  %34 = getelementptr inbounds i32, ptr %0, i64 %33
+  %35 = load i32, ptr %34, align 4, !tbaa !5
+  %36 = shl nsw i32 %35, 1
+  %37 = getelementptr inbounds i32, ptr %1, i64 %33
+  store i32 %36, ptr %37, align 4, !tbaa !5
+  %38 = add nuw nsw i64 %33, 1
+  %39 = icmp eq i64 %38, %16
+  br i1 %39, label %17, label %32, !llvm.loop !27
+}
+
+; Function Attrs: nofree norecurse nosync nounwind ssp memory(argmem: readwrite) uwtable
+define void @r(ptr noalias nocapture noundef %0, ptr noalias nocapture noundef %1, i32 noundef %2) local_unnamed_addr #0 {
+  %4 = alloca [1024 x i32], align 16
+  call void @llvm.lifetime.start.p0(i64 4096, ptr nonnull %4) #2
+  %5 = icmp sgt i32 %2, 0
+  br i1 %5, label %6, label %8
+
+6:                                                ; preds = %3
+  %7 = zext i32 %2 to i64
+  br label %13
+
+8:                                                ; preds = %13, %3
+  %9 = icmp sgt i32 %2, 0
+  br i1 %9, label %10, label %12
+
+10:                                               ; preds = %8
+  %11 = zext i32 %2 to i64
+  br label %21
+
+12:                                               ; preds = %21, %8
+  call void @llvm.lifetime.end.p0(i64 4096, ptr nonnull %4) #2
+  ret void
+
+13:                                               ; preds = %13, %6
+  %14 = phi i64 [ 0, %6 ], [ %19, %13 ]
+  %15 = getelementptr inbounds i32, ptr %0, i64 %14
+  %16 = load i32, ptr %15, align 4, !tbaa !5
+  %17 = shl nsw i32 %16, 1
+  %18 = getelementptr inbounds [1024 x i32], ptr %4, i64 0, i64 %14
+  store i32 %17, ptr %18, align 4, !tbaa !5
+  %19 = add nuw nsw i64 %14, 1
+  %20 = icmp eq i64 %19, %7
+  br i1 %20, label %8, label %13, !llvm.loop !28
+
+21:                                               ; preds = %21, %10
+  %22 = phi i64 [ 0, %10 ], [ %27, %21 ]
+  %23 = getelementptr inbounds [1024 x i32], ptr %4, i64 0, i64 %22
+  %24 = load i32, ptr %23, align 4, !tbaa !5
+  %25 = add nsw i32 %24, 1
+  %26 = getelementptr inbounds i32, ptr %1, i64 %22
+  store i32 %25, ptr %26, align 4, !tbaa !5
+  %27 = add nuw nsw i64 %22, 1
+  %28 = icmp eq i64 %27, %11
+  br i1 %28, label %12, label %21, !llvm.loop !29
+}
+
+; Function Attrs: nofree norecurse nosync nounwind ssp memory(argmem: readwrite) uwtable
+define void @s(ptr noalias nocapture noundef %0, ptr noalias nocapture noundef %1, ptr noalias nocapture noundef %2, i32 noundef %3) local_unnamed_addr #0 {
+  %5 = icmp sgt i32 %3, 0
+  br i1 %5, label %6, label %8
+
+6:                                                ; preds = %4
+  %7 = zext i32 %3 to i64
+  br label %17
+
+8:                                                ; preds = %17, %4
+  %9 = load i32, ptr %2, align 4, !tbaa !5
+  %10 = mul nsw i32 %9, 3
+  %11 = load i32, ptr %0, align 4, !tbaa !5
+  %12 = getelementptr inbounds i32, ptr %2, i64 1
+  store i32 %11, ptr %12, align 4, !tbaa !5
+  %13 = icmp sgt i32 %3, 0
+  br i1 %13, label %14, label %16
+
+14:                                               ; preds = %8
+  %15 = zext i32 %3 to i64
+  br label %24
+
+16:                                               ; preds = %24, %8
+  ret void
+
+17:                                               ; preds = %17, %6
+  %18 = phi i64 [ 0, %6 ], [ %22, %17 ]
+  %19 = getelementptr inbounds i32, ptr %0, i64 %18
+  %20 = load i32, ptr %19, align 4, !tbaa !5
+  %21 = add nsw i32 %20, 1
+  store i32 %21, ptr %19, align 4, !tbaa !5
+  %22 = add nuw nsw i64 %18, 1
+  %23 = icmp eq i64 %22, %7
+  br i1 %23, label %8, label %17, !llvm.loop !30
+
+24:                                               ; preds = %24, %14
+  %25 = phi i64 [ 0, %14 ], [ %30, %24 ]
+  %26 = getelementptr inbounds i32, ptr %0, i64 %25
+  %27 = load i32, ptr %26, align 4, !tbaa !5
+  %28 = add nsw i32 %27, %10
+  %29 = getelementptr inbounds i32, ptr %1, i64 %25
+  store i32 %28, ptr %29, align 4, !tbaa !5
+  %30 = add nuw nsw i64 %25, 1
+  %31 = icmp eq i64 %30, %15
+  br i1 %31, label %16, label %24, !llvm.loop !31
+}
+
+; Function Attrs: nofree norecurse nosync nounwind ssp memory(argmem: readwrite) uwtable
+define void @t(ptr noalias nocapture noundef %0, ptr noalias nocapture noundef %1, i32 noundef %2) local_unnamed_addr #0 {
+  %4 = icmp sgt i32 %2, 0
+  br i1 %4, label %5, label %7
+
+5:                                                ; preds = %3
+  %6 = zext i32 %2 to i64
+  br label %12
+
+7:                                                ; preds = %19, %3
+  %8 = icmp sgt i32 %2, 0
+  br i1 %8, label %9, label %11
+
+9:                                                ; preds = %7
+  %10 = zext i32 %2 to i64
+  br label %22
+
+11:                                               ; preds = %30, %7
+  ret void
+
+12:                                               ; preds = %19, %5
+  %13 = phi i64 [ 0, %5 ], [ %20, %19 ]
+  %14 = getelementptr inbounds i32, ptr %0, i64 %13
+  %15 = load i32, ptr %14, align 4, !tbaa !5
+  %16 = icmp sgt i32 %15, 0
+  br i1 %16, label %17, label %19
+
+17:                                               ; preds = %12
+  %18 = add nsw i32 %15, -1
+  store i32 %18, ptr %14, align 4, !tbaa !5
+  br label %19
+
+19:                                               ; preds = %17, %12
+  %20 = add nuw nsw i64 %13, 1
+  %21 = icmp eq i64 %20, %6
+  br i1 %21, label %7, label %12, !llvm.loop !32
+
+22:                                               ; preds = %30, %9
+  %23 = phi i64 [ 0, %9 ], [ %31, %30 ]
+  %24 = getelementptr inbounds i32, ptr %0, i64 %23
+  %25 = load i32, ptr %24, align 4, !tbaa !5
+  %26 = getelementptr inbounds i32, ptr %1, i64 %23
+  %27 = icmp sgt i32 %25, 0
+  br i1 %27, label %28, label %29
+
+28:                                               ; preds = %22
+  store i32 %25, ptr %26, align 4, !tbaa !5
+  br label %30
+
+29:                                               ; preds = %22
+  store i32 0, ptr %26, align 4, !tbaa !5
+  br label %30
+
+30:                                               ; preds = %29, %28
+  %31 = add nuw nsw i64 %23, 1
+  %32 = icmp eq i64 %31, %10
+  br i1 %32, label %11, label %22, !llvm.loop !29
+}
+
+; Function Attrs: nofree norecurse nosync nounwind ssp memory(argmem: readwrite) uwtable
+define void @u(ptr noalias nocapture noundef %0, ptr noalias nocapture noundef %1, i32 noundef %2) local_unnamed_addr #0 {
+  br label %4
+
+4:                                                ; preds = %14, %3
+  %5 = phi i32 [ 0, %3 ], [ %15, %14 ]
+  %6 = icmp slt i32 %5, %2
+  br i1 %6, label %7, label %16
+
+7:                                                ; preds = %4
+  %8 = sext i32 %5 to i64
+  %9 = getelementptr inbounds i32, ptr %0, i64 %8
+  %10 = load i32, ptr %9, align 4, !tbaa !5
+  %11 = icmp sgt i32 %10, 0
+  br i1 %11, label %12, label %14
+
+12:                                               ; preds = %7
+  %13 = add nsw i32 %10, -1
+  store i32 %13, ptr %9, align 4, !tbaa !5
+  br label %14
+
+14:                                               ; preds = %12, %7
+  %15 = add nsw i32 %5, 1
+  br label %4, !llvm.loop !34
+
+16:                                               ; preds = %4
+  br label %17
+
+17:                                               ; preds = %28, %16
+  %18 = phi i32 [ 0, %16 ], [ %29, %28 ]
+  %19 = icmp slt i32 %18, %2
+  br i1 %19, label %20, label %30
+
+20:                                               ; preds = %17
+  %21 = sext i32 %18 to i64
+  %22 = getelementptr inbounds i32, ptr %0, i64 %21
+  %23 = load i32, ptr %22, align 4, !tbaa !5
+  %24 = getelementptr inbounds i32, ptr %1, i64 %21
+  %25 = icmp sgt i32 %23, 0
+  br i1 %25, label %26, label %27
+
+26:                                               ; preds = %20
+  store i32 %23, ptr %24, align 4, !tbaa !5
+  br label %28
+
+27:                                               ; preds = %20
+  store i32 0, ptr %24, align 4, !tbaa !5
+  br label %28
+
+28:                                               ; preds = %27, %26
+  %29 = add nsw i32 %18, 1
+  br label %17, !llvm.loop !35
+
+30:                                               ; preds = %17
+  ret void
+}
+
+; Function Attrs: nofree norecurse nosync nounwind ssp memory(argmem: readwrite) uwtable
+define void @v(ptr noalias nocapture noundef %0, ptr noalias nocapture noundef %1, i32 noundef %2) local_unnamed_addr #0 {
+  %4 = icmp sgt i32 %2, 0
+  br i1 %4, label %5, label %7
+
+5:                                                ; preds = %3
+  %6 = zext i32 %2 to i64
+  br label %13
+
+7:                                                ; preds = %13, %3
+  %8 = icmp sgt i32 %2, 1
+  br i1 %8, label %9, label %12
+
+9:                                                ; preds = %7
+  %10 = add nsw i32 %2, -1
+  %11 = zext i32 %10 to i64
+  br label %20
+
+12:                                               ; preds = %20, %7
+  ret void
+
+13:                                               ; preds = %5, %13
+  %14 = phi i64 [ 0, %5 ], [ %18, %13 ]
+  %15 = getelementptr inbounds i32, ptr %0, i64 %14
+  %16 = load i32, ptr %15, align 4, !tbaa !5
+  %17 = add nsw i32 %16, 1
+  store i32 %17, ptr %15, align 4, !tbaa !5
+  %18 = add nuw nsw i64 %14, 1
+  %19 = icmp eq i64 %18, %6
+  br i1 %19, label %7, label %13, !llvm.loop !36
+
+20:                                               ; preds = %9, %20
+  %21 = phi i64 [ 0, %9 ], [ %25, %20 ]
+  %22 = getelementptr inbounds i32, ptr %1, i64 %21
+  %23 = load i32, ptr %22, align 4, !tbaa !5
+  %24 = add nsw i32 %23, 2
+  store i32 %24, ptr %22, align 4, !tbaa !5
+  %25 = add nuw nsw i64 %21, 1
+  %26 = icmp eq i64 %25, %11
+  br i1 %26, label %12, label %20, !llvm.loop !37
+}
+
+; Function Attrs: nofree norecurse nosync nounwind ssp memory(argmem: readwrite) uwtable
+define void @w(ptr noalias nocapture noundef %0, ptr noalias nocapture noundef %1, i32 noundef %2) local_unnamed_addr #0 {
+  %4 = icmp sgt i32 %2, 3
+  br i1 %4, label %5, label %8
+
+5:                                                ; preds = %3
+  %6 = add nsw i32 %2, -3
+  %7 = zext i32 %6 to i64
+  br label %12
+
+8:                                                ; preds = %12, %3
+  %9 = icmp sgt i32 %2, 1
+  br i1 %9, label %10, label %19
+
+10:                                               ; preds = %8
+  %11 = zext i32 %2 to i64
+  br label %20
+
+12:                                               ; preds = %5, %12
+  %13 = phi i64 [ 0, %5 ], [ %17, %12 ]
+  %14 = getelementptr inbounds i32, ptr %0, i64 %13
+  %15 = load i32, ptr %14, align 4, !tbaa !5
+  %16 = add nsw i32 %15, 1
+  store i32 %16, ptr %14, align 4, !tbaa !5
+  %17 = add nuw nsw i64 %13, 1
+  %18 = icmp eq i64 %17, %7
+  br i1 %18, label %8, label %12, !llvm.loop !38
+
+19:                                               ; preds = %20, %8
+  ret void
+
+20:                                               ; preds = %10, %20
+  %21 = phi i64 [ 1, %10 ], [ %25, %20 ]
+  %22 = getelementptr inbounds i32, ptr %1, i64 %21
+  %23 = load i32, ptr %22, align 4, !tbaa !5
+  %24 = add nsw i32 %23, 2
+  store i32 %24, ptr %22, align 4, !tbaa !5
+  %25 = add nuw nsw i64 %21, 1
+  %26 = icmp eq i64 %25, %11
+  br i1 %26, label %19, label %20, !llvm.loop !39
+}
+
+; Function Attrs: nofree norecurse nosync nounwind ssp memory(argmem: readwrite) uwtable
+define void @x(ptr noalias nocapture noundef readonly %0, ptr noalias nocapture noundef %1, ptr noalias nocapture noundef %2, ptr noalias nocapture noundef writeonly %3, i32 noundef %4) local_unnamed_addr #0 {
+  %6 = icmp sgt i32 %4, 0
+  br i1 %6, label %7, label %9
+
+7:                                                ; preds = %5
+  %8 = zext i32 %4 to i64
+  br label %17
+
+9:                                                ; preds = %17, %5
+  %10 = icmp sgt i32 %4, 0
+  br i1 %10, label %11, label %13
+
+11:                                               ; preds = %9
+  %12 = zext i32 %4 to i64
+  br label %25
+
+13:                                               ; preds = %25, %9
+  %14 = icmp sgt i32 %4, 0
+  br i1 %14, label %15, label %33
+
+15:                                               ; preds = %13
+  %16 = zext i32 %4 to i64
+  br label %34
+
+17:                                               ; preds = %7, %17
+  %18 = phi i64 [ 0, %7 ], [ %23, %17 ]
+  %19 = getelementptr inbounds i32, ptr %0, i64 %18
+  %20 = load i32, ptr %19, align 4, !tbaa !5
+  %21 = add nsw i32 %20, 1
+  %22 = getelementptr inbounds i32, ptr %1, i64 %18
+  store i32 %21, ptr %22, align 4, !tbaa !5
+  %23 = add nuw nsw i64 %18, 1
+  %24 = icmp eq i64 %23, %8
+  br i1 %24, label %9, label %17, !llvm.loop !40
+
+25:                                               ; preds = %11, %25
+  %26 = phi i64 [ 0, %11 ], [ %31, %25 ]
+  %27 = getelementptr inbounds i32, ptr %1, i64 %26
+  %28 = load i32, ptr %27, align 4, !tbaa !5
+  %29 = add nsw i32 %28, 1
+  %30 = getelementptr inbounds i32, ptr %2, i64 %26
+  store i32 %29, ptr %30, align 4, !tbaa !5
+  %31 = add nuw nsw i64 %26, 1
+  %32 = icmp eq i64 %31, %12
+  br i1 %32, label %13, label %25, !llvm.loop !41
+
+33:                                               ; preds = %34, %13
+  ret void
+
+34:                                               ; preds = %15, %34
+  %35 = phi i64 [ 0, %15 ], [ %40, %34 ]
+  %36 = getelementptr inbounds i32, ptr %2, i64 %35
+  %37 = load i32, ptr %36, align 4, !tbaa !5
+  %38 = add nsw i32 %37, 1
+  %39 = getelementptr inbounds i32, ptr %3, i64 %35
+  store i32 %38, ptr %39, align 4, !tbaa !5
+  %40 = add nuw nsw i64 %35, 1
+  %41 = icmp eq i64 %40, %16
+  br i1 %41, label %33, label %34, !llvm.loop !42
+}
+
+; Function Attrs: mustprogress nocallback nofree nosync nounwind willreturn memory(argmem: readwrite)
+declare void @llvm.lifetime.start.p0(i64 immarg, ptr nocapture) #1
+
+; Function Attrs: mustprogress nocallback nofree nosync nounwind willreturn memory(argmem: readwrite)
+declare void @llvm.lifetime.end.p0(i64 immarg, ptr nocapture) #1
+
 attributes #0 = { nofree norecurse nosync nounwind ssp memory(argmem: readwrite) uwtable "frame-pointer"="all" "min-legal-vector-width"="0" "no-trapping-math"="true" "stack-protector-buffer-size"="8" "target-cpu"="penryn" "target-features"="+cmov,+cx16,+cx8,+fxsr,+mmx,+sahf,+sse,+sse2,+sse3,+sse4.1,+ssse3,+x87" "tune-cpu"="generic" }
+attributes #1 = { mustprogress nocallback nofree nosync nounwind willreturn memory(argmem: readwrite) }
+attributes #2 = { nounwind }
 
 !llvm.module.flags = !{!0, !1, !2, !3}
 !llvm.ident = !{!4}
@@ -62,3 +742,33 @@ attributes #0 = { nofree norecurse nosync nounwind ssp memory(argmem: readwrite)
 !10 = !{!"llvm.loop.mustprogress"}
 !11 = !{!"llvm.loop.unroll.disable"}
 !12 = distinct !{!12, !10, !11}
+!13 = distinct !{!13, !10, !11}
+!14 = distinct !{!14, !10, !11}
+!15 = distinct !{!15, !10, !11}
+!16 = distinct !{!16, !10, !11}
+!17 = distinct !{!17, !10, !11}
+!18 = distinct !{!18, !10, !11}
+!19 = distinct !{!19, !10, !11}
+!20 = distinct !{!20, !10, !11}
+!21 = distinct !{!21, !10, !11}
+!22 = distinct !{!22, !10, !11}
+!23 = distinct !{!23, !10, !11}
+!24 = distinct !{!24, !10, !11}
+!25 = distinct !{!25, !10, !11}
+!26 = distinct !{!26, !10, !11}
+!27 = distinct !{!27, !10, !11}
+!28 = distinct !{!28, !10, !11}
+!29 = distinct !{!29, !10, !11}
+!30 = distinct !{!30, !10, !11}
+!31 = distinct !{!31, !10, !11}
+!32 = distinct !{!32, !10, !11}
+!33 = distinct !{!33, !10, !11}
+!34 = distinct !{!34, !10, !11}
+!35 = distinct !{!35, !10, !11}
+!36 = distinct !{!36, !10, !11}
+!37 = distinct !{!37, !10, !11}
+!38 = distinct !{!38, !10, !11}
+!39 = distinct !{!39, !10, !11}
+!40 = distinct !{!40, !10, !11}
+!41 = distinct !{!41, !10, !11}
+!42 = distinct !{!42, !10, !11}